@@ -47,3 +47,53 @@ struct scnhdr {
         long            s_flags;        /* flags */
       };
  
+
+/* The symbolic header, pointed to by f_symptr.  We only use it to find
+ * the external symbols, which include every global procedure.
+ */
+
+struct symhdr {
+        short           magic;          /* to verify validity of table */
+        short           vstamp;         /* version stamp */
+        long            ilineMax;       /* number of line number entries */
+        long            cbLine;         /* number of bytes for line numbers */
+        long            cbLineOffset;   /* offset to start of line numbers */
+        long            idnMax;         /* max index into dense numbers */
+        long            cbDnOffset;     /* offset to start of dense numbers */
+        long            ipdMax;         /* number of procedures */
+        long            cbPdOffset;     /* offset to procedure descriptors */
+        long            isymMax;        /* number of local symbols */
+        long            cbSymOffset;    /* offset to start of local symbols */
+        long            ioptMax;        /* max index into optimization table */
+        long            cbOptOffset;    /* offset to optimization table */
+        long            iauxMax;        /* number of auxiliary symbols */
+        long            cbAuxOffset;    /* offset to auxiliary symbols */
+        long            issMax;         /* max index into local strings */
+        long            cbSsOffset;     /* offset to local strings */
+        long            issExtMax;      /* max index into external strings */
+        long            cbSsExtOffset;  /* offset to external strings */
+        long            ifdMax;         /* number of file descriptors */
+        long            cbFdOffset;     /* offset to file descriptors */
+        long            crfd;           /* number of relative file descriptors */
+        long            cbRfdOffset;    /* offset to relative file descriptors */
+        long            iextMax;        /* number of external symbols */
+        long            cbExtOffset;    /* offset to external symbols */
+      };
+
+#define SYMHDRMAGIC     0x7009
+
+struct extsym {
+        unsigned char   es_bits1;       /* weak, cobol main, jump table */
+        unsigned char   es_bits2;       /* reserved */
+        short           es_ifd;         /* file where symbol is defined */
+        long            es_iss;         /* index into external strings */
+        long            es_value;       /* address, for procedures */
+        unsigned long   es_bits;        /* st:6, sc:5, reserved:1, index:20 */
+      };
+
+#define SymType(bits)   ((bits) & 0x3f)
+#define SymClass(bits)  (((bits) >> 6) & 0x1f)
+
+#define stProc          6               /* symbol types we care about */
+#define stStaticProc    14
+#define scText          1               /* storage class: in .text */
@@ -10,6 +10,11 @@
  * 	ld with  -N -T 0
  * to make sure the object file has no shared text.
  *
+ * The addresses of the procedures in the COFF symbol table are written
+ * to a separate text file, <noffFileName>.sym, one "address name" pair
+ * per line, for the Nachos profiler.  The NOFF file itself has no room
+ * for symbols.
+ *
  * Also assumes that the COFF file has at most 3 segments:
  *	.text	-- read-only executable instructions 
  *	.data	-- initialized data
@@ -89,6 +94,59 @@ void Write(int fd, char *buf, int nBytes)
     }
 }
 
+/* Write out the address and name of each procedure in the external
+ * symbol table.  A COFF file without symbols (e.g., stripped) simply 
+ * gets no symbol file.
+ */
+void WriteSymbols(int fdIn, struct filehdr *fileh, char *noffName)
+{
+    struct symhdr symh;
+    struct extsym ext;
+    char *strings, *symFileName;
+    FILE *fp;
+    int i;
+
+    if (fileh->f_symptr == 0)
+	return;
+    lseek(fdIn, WordToHost(fileh->f_symptr), 0);
+    ReadStruct(fdIn, symh);
+    if (ShortToHost(symh.magic) != SYMHDRMAGIC) {
+	fprintf(stderr, "Bad symbol table, no symbols written\n");
+	return;
+    }
+    symh.issExtMax = WordToHost(symh.issExtMax);
+    symh.iextMax = WordToHost(symh.iextMax);
+
+    strings = malloc(symh.issExtMax + 1);
+    lseek(fdIn, WordToHost(symh.cbSsExtOffset), 0);
+    Read(fdIn, strings, symh.issExtMax);
+    strings[symh.issExtMax] = '\0';
+
+    symFileName = malloc(strlen(noffName) + 5);
+    sprintf(symFileName, "%s.sym", noffName);
+    if ((fp = fopen(symFileName, "w")) == NULL) {
+	perror(symFileName);
+	free(strings);
+	free(symFileName);
+	return;
+    }
+    lseek(fdIn, WordToHost(symh.cbExtOffset), 0);
+    for (i = 0; i < symh.iextMax; i++) {
+	ReadStruct(fdIn, ext);
+	ext.es_iss = WordToHost(ext.es_iss);
+	ext.es_bits = WordToHost(ext.es_bits);
+	if ((SymType(ext.es_bits) == stProc 
+			|| SymType(ext.es_bits) == stStaticProc)
+		&& SymClass(ext.es_bits) == scText
+		&& ext.es_iss >= 0 && ext.es_iss < symh.issExtMax)
+	    fprintf(fp, "%x %s\n", WordToHost(ext.es_value), 
+			&strings[ext.es_iss]);
+    }
+    fclose(fp);
+    free(strings);
+    free(symFileName);
+}
+
 main (int argc, char **argv)
 {
     int fdIn, fdOut, numsections, i, inNoffFile;
@@ -221,6 +279,7 @@ main (int argc, char **argv)
     }
     lseek(fdOut, 0, 0);
     Write(fdOut, (char *)&noffH, sizeof(NoffHeader));
+    WriteSymbols(fdIn, &fileh, noffFileName);
     close(fdIn);
     close(fdOut);
     exit(0);
@@ -0,0 +1,193 @@
+/* tracedump.c
+ *
+ * This program reads a Nachos event trace (written by "nachos -T file")
+ * and prints it, either as text, one event per line, or with -j as
+ * JSON in the Chrome trace event format, for chrome://tracing or
+ * similar viewers.  In the JSON, one tick is shown as one microsecond;
+ * the time each thread spends on the CPU is a slice on its own row.
+ *
+ * The trace must be read on the same kind of host that wrote it.
+ *
+ * Usage: tracedump [-j] <traceFile>
+ *
+ * Copyright (c) 1992-1993 The Regents of the University of California.
+ * All rights reserved.  See copyright.h for copyright notice and limitation
+ * of liability and disclaimer of warranty provisions.
+ */
+
+#define MAIN
+#include "copyright.h"
+#undef MAIN
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tracefmt.h"
+
+/* These must match the enums in machine/interrupt.h and machine/machine.h */
+static char *intTypeNames[] = { "timer", "disk", "console write",
+			"console read", "elevator", "network send",
+			"network recv", "cache flush" };
+static char *exceptionNames[] = { "no exception", "syscall",
+			"page fault", "read-only", "bus error",
+			"address error", "overflow", "illegal instruction" };
+
+#define NameOf(table, i) \
+    (((i) < sizeof(table) / sizeof(table[0])) ? table[i] : "unknown")
+
+static TraceName *names;
+static int numNames;
+
+/* The name of a thread, from the table at the end of the trace. */
+static char *
+ThreadName(unsigned int thread)
+{
+    static char buf[16];
+    int i;
+
+    for (i = 0; i < numNames; i++)
+	if (names[i].thread == thread)
+	    return names[i].name;
+    sprintf(buf, "thread %u", thread);
+    return buf;
+}
+
+/* Describe an event in words. */
+static void
+Describe(TraceRecord *r, char *buf)
+{
+    switch (r->type) {
+      case TraceSwitch:
+	sprintf(buf, "switch to \"%s\"", ThreadName(r->arg1));
+	break;
+      case TraceInterrupt:
+	sprintf(buf, "%s interrupt", NameOf(intTypeNames, r->arg1));
+	break;
+      case TraceDiskRead:
+      case TraceDiskWrite:
+	sprintf(buf, "disk %s, sector %u", 
+		(r->type == TraceDiskRead) ? "read" : "write", r->arg1);
+	if (r->arg2 > 1)
+	    sprintf(buf + strlen(buf), "-%u", r->arg1 + r->arg2 - 1);
+	break;
+      case TraceException:
+	sprintf(buf, "%s exception, address 0x%x",
+		NameOf(exceptionNames, r->arg1), r->arg2);
+	break;
+      case TraceSyscall:
+	sprintf(buf, "syscall %u", r->arg1);
+	break;
+      case TraceFinish:
+	sprintf(buf, "finish");
+	break;
+      default:
+	sprintf(buf, "unknown event %u (%u, %u)", r->type, r->arg1, r->arg2);
+	break;
+    }
+}
+
+static void
+PrintText(TraceFileHeader *h, TraceRecord *records)
+{
+    char buf[128];
+    unsigned int i;
+
+    if (h->dropped > 0)
+	printf("(%u earlier events dropped)\n", h->dropped);
+    for (i = 0; i < h->numRecords; i++) {
+	Describe(&records[i], buf);
+	printf("%10u  %-16s %s\n", records[i].time,
+		ThreadName(records[i].thread), buf);
+    }
+}
+
+static void
+PrintJSON(TraceFileHeader *h, TraceRecord *records)
+{
+    char buf[128];
+    unsigned int i, start, running;
+    int first = 1;
+
+    printf("{\"traceEvents\": [\n");
+    for (i = 0; i < numNames; i++) {
+	printf("%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, "
+		"\"tid\": %u, \"args\": {\"name\": \"%s\"}}",
+		first ? "" : ",\n", names[i].thread, names[i].name);
+	first = 0;
+    }
+    start = (h->numRecords > 0) ? records[0].time : 0;
+    running = (h->numRecords > 0) ? records[0].thread : 0;
+    for (i = 0; i < h->numRecords; i++) {
+	TraceRecord *r = &records[i];
+
+	if (r->type == TraceSwitch) {		/* end the old slice */
+	    printf("%s{\"name\": \"running\", \"ph\": \"X\", \"pid\": 0, "
+		"\"tid\": %u, \"ts\": %u, \"dur\": %u}", first ? "" : ",\n",
+		running, start, r->time - start);
+	    first = 0;
+	    running = r->arg1;
+	    start = r->time;
+	    continue;
+	}
+	Describe(r, buf);
+	printf("%s{\"name\": \"%s\", \"ph\": \"i\", \"s\": \"t\", "
+		"\"pid\": 0, \"tid\": %u, \"ts\": %u}", first ? "" : ",\n",
+		buf, r->thread, r->time);
+	first = 0;
+    }
+    if (h->numRecords > 0)
+	printf("%s{\"name\": \"running\", \"ph\": \"X\", \"pid\": 0, "
+		"\"tid\": %u, \"ts\": %u, \"dur\": %u}", first ? "" : ",\n",
+		running, start, records[h->numRecords - 1].time - start);
+    printf("\n]}\n");
+}
+
+int
+main(int argc, char **argv)
+{
+    TraceFileHeader header;
+    TraceRecord *records;
+    int json = 0;
+    FILE *fp;
+
+    if (argc > 1 && !strcmp(argv[1], "-j")) {
+	json = 1;
+	argc--, argv++;
+    }
+    if (argc != 2) {
+	fprintf(stderr, "Usage: tracedump [-j] <traceFile>\n");
+	exit(1);
+    }
+    if ((fp = fopen(argv[1], "r")) == NULL) {
+	perror(argv[1]);
+	exit(1);
+    }
+    if (fread(&header, sizeof(header), 1, fp) != 1
+		|| header.magic != TRACEMAGIC) {
+	fprintf(stderr, "%s is not a Nachos trace\n", argv[1]);
+	exit(1);
+    }
+    if (header.version != TRACEVERSION) {
+	fprintf(stderr, "%s is version %u, expected %u\n", argv[1],
+		header.version, TRACEVERSION);
+	exit(1);
+    }
+    records = (TraceRecord *) malloc(header.numRecords * sizeof(TraceRecord));
+    names = (TraceName *) malloc(header.numNames * sizeof(TraceName));
+    numNames = header.numNames;
+    if (fread(records, sizeof(TraceRecord), header.numRecords, fp)
+		!= header.numRecords
+	    || fread(names, sizeof(TraceName), header.numNames, fp)
+		!= header.numNames) {
+	fprintf(stderr, "%s is too short\n", argv[1]);
+	exit(1);
+    }
+    fclose(fp);
+
+    if (json)
+	PrintJSON(&header, records);
+    else
+	PrintText(&header, records);
+    exit(0);
+}
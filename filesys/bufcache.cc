@@ -0,0 +1,634 @@
+// bufcache.cc
+//	Routines to manage the cache of disk sectors.  See bufcache.h
+//	for an overview.
+//
+//	The cache's data structures are protected by disabling interrupts,
+//	as in synch.cc.  Since a thread doing disk I/O goes to sleep, and
+//	other threads can run meanwhile, a buffer that is being read or
+//	written is marked "busy"; anyone else who wants it must wait.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "bufcache.h"
+#include "system.h"
+#include <strings.h>
+
+//----------------------------------------------------------------------
+// CacheFlushTimer
+// 	Interrupt handler for the flush timer.  Need this to be a C
+//	routine, because C++ can't handle pointers to member functions.
+//----------------------------------------------------------------------
+
+static void
+CacheFlushTimer(int arg)
+{
+    BufferCache *cache = (BufferCache *) arg;
+
+    cache->FlushTimerExpired();
+}
+
+//----------------------------------------------------------------------
+// CachePrefetchDone
+// 	Called from the disk interrupt handler when a read started by
+//	Prefetch completes.
+//----------------------------------------------------------------------
+
+static void
+CachePrefetchDone(int arg)
+{
+    Buffer *b = (Buffer *) arg;
+
+    bufferCache->PrefetchDone(b);
+}
+
+//----------------------------------------------------------------------
+// CacheFlusher
+// 	The flusher thread.  Each time the flush timer goes off, write
+//	back what is dirty.
+//----------------------------------------------------------------------
+
+static void
+CacheFlusher(int arg)
+{
+    BufferCache *cache = (BufferCache *) arg;
+
+    for (;;) {
+	cache->flushWanted->P();
+	cache->FlushDirty();
+    }
+}
+
+//----------------------------------------------------------------------
+// BufferCache::BufferCache
+// 	Initialize an empty cache, and fork the flusher thread.
+//
+//	"theDisk" -- the disk to cache
+//----------------------------------------------------------------------
+
+BufferCache::BufferCache(SynchDisk *theDisk)
+{
+    Thread *flusher;
+    int i;
+
+    disk = theDisk;
+    pool = new char[NumBuffers * SectorSize];
+    for (i = 0; i < CacheBuckets; i++)
+	buckets[i] = NULL;
+    for (i = 0; i < NumBuffers; i++) {
+	buffers[i].sector = -1;
+	buffers[i].data = &pool[i * SectorSize];
+	buffers[i].dirty = buffers[i].busy = buffers[i].prefetched = FALSE;
+	buffers[i].pinCount = buffers[i].waiters = 0;
+	buffers[i].idle = new Semaphore("buffer idle", 0);
+	buffers[i].hashNext = NULL;
+	buffers[i].newer = (i > 0) ? &buffers[i - 1] : NULL;
+	buffers[i].older = (i < NumBuffers - 1) ? &buffers[i + 1] : NULL;
+    }
+    newest = &buffers[0];
+    oldest = &buffers[NumBuffers - 1];
+    freeWaiters = 0;
+    bufferFreed = new Semaphore("buffer freed", 0);
+    flushScheduled = FALSE;
+    flushWanted = new Semaphore("cache flush", 0);
+
+    flusher = new Thread("cache flusher");
+    flusher->Fork(CacheFlusher, (void *) this);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::~BufferCache
+// 	De-allocate the cache.  The flusher thread is left asleep; this
+//	is only done when Nachos halts.
+//----------------------------------------------------------------------
+
+BufferCache::~BufferCache()
+{
+    for (int i = 0; i < NumBuffers; i++)
+	delete buffers[i].idle;
+    delete bufferFreed;
+    delete [] pool;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ReadSector
+// 	Copy the contents of a sector into "data", going to the disk
+//	only if the sector isn't cached.
+//----------------------------------------------------------------------
+
+void
+BufferCache::ReadSector(int sector, char *data)
+{
+    Buffer *b = Get(sector, TRUE);
+
+    bcopy(b->data, data, SectorSize);
+    Unpin(b->data, FALSE);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::WriteSector
+// 	Change the contents of a sector.  The new contents are written
+//	to disk later.
+//----------------------------------------------------------------------
+
+void
+BufferCache::WriteSector(int sector, char *data)
+{
+    Buffer *b = Get(sector, FALSE);
+
+    bcopy(data, b->data, SectorSize);
+    Unpin(b->data, TRUE);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ReadSectors
+// 	Copy the contents of a run of consecutive sectors into "data".
+//	Sectors that are cached are copied from the cache; each run of 
+//	sectors that aren't is read straight into "data" with one
+//	SynchDisk::ReadSectors, so that the disk can transfer them one
+//	after another, instead of a sector at a time.
+//
+//	Before reading a run, we take a clean buffer for each sector of
+//	it, if there is one to spare, and keep it busy until the data is
+//	copied in, so that anyone else who wants the sector meanwhile
+//	waits for it.  A sector we found no buffer for isn't cached: it
+//	may have been written while we slept, so what we read may be out
+//	of date.
+//
+//	"sector" -- the first sector
+//	"count" -- how many sectors
+//	"data" -- where to put them, count * SectorSize bytes
+//----------------------------------------------------------------------
+
+void
+BufferCache::ReadSectors(int sector, int count, char *data)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Buffer **claimed = new Buffer *[count];
+    Buffer *b;
+    int i, j;
+
+    ASSERT((sector >= 0) && (sector + count <= NumSectors));
+    for (i = 0; i < count; ) {
+	b = Find(sector + i);
+	if (b != NULL) {
+	    if (b->busy) {
+		WaitIdle(b);
+		continue;
+	    }
+	    stats->numCacheHits++;
+	    if (b->prefetched) {
+		stats->numPrefetchHits++;
+		b->prefetched = FALSE;
+	    }
+	    Touch(b);
+	    bcopy(b->data, &data[i * SectorSize], SectorSize);
+	    i++;
+	    continue;
+	}
+
+	for (j = i + 1; j < count; j++)		// how far the run goes
+	    if (Find(sector + j) != NULL)
+		break;
+	for (int k = i; k < j; k++) {
+	    stats->numCacheMisses++;
+	    b = claimed[k] = Victim();
+	    if (b != NULL) {
+		Rehash(b, sector + k);
+		Touch(b);
+		b->busy = TRUE;
+		b->prefetched = FALSE;
+	    }
+	}
+	disk->ReadSectors(sector + i, j - i, &data[i * SectorSize]);
+	for (int k = i; k < j; k++)
+	    if (claimed[k] != NULL) {
+		bcopy(&data[k * SectorSize], claimed[k]->data, SectorSize);
+		MakeIdle(claimed[k]);
+	    }
+	for (; i < j; i++) {
+	    if (claimed[i] != NULL)
+		continue;
+	    while (((b = Find(sector + i)) != NULL) && b->busy)
+		WaitIdle(b);
+	    if (b != NULL)		// cached while we slept; it's newer
+		bcopy(b->data, &data[i * SectorSize], SectorSize);
+	}
+    }
+    delete [] claimed;
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Pin
+// 	Return the cached copy of a sector, which the caller can read or
+//	change in place until it calls Unpin.
+//
+//	"overwrite" -- if TRUE, the caller is going to set the whole
+//		sector, so there's no need to read it from disk
+//----------------------------------------------------------------------
+
+char *
+BufferCache::Pin(int sector, bool overwrite)
+{
+    return Get(sector, !overwrite)->data;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Unpin
+// 	Release a sector returned by Pin (or Get).  If the sector was
+//	changed, it will be written back to disk later.
+//
+//	"data" -- what Pin returned
+//	"dirtied" -- did the caller change it?
+//----------------------------------------------------------------------
+
+void
+BufferCache::Unpin(char *data, bool dirtied)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Buffer *b = &buffers[(data - pool) / SectorSize];
+
+    ASSERT(b->data == data && b->pinCount > 0);
+    b->pinCount--;
+    if (dirtied)
+	b->dirty = TRUE;
+    if (b->pinCount == 0) {
+	if (b->dirty)
+	    ScheduleFlush();
+	for (; freeWaiters > 0; freeWaiters--)
+	    bufferFreed->V();
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Get
+// 	Find the buffer holding a sector, pinned.  If it isn't cached,
+//	take over the least recently used buffer that isn't pinned,
+//	writing it back first if it is dirty (along with the dirty
+//	sectors after it on its track).
+//
+//	Whenever we sleep, other threads may change the cache, so we
+//	look again from the top.
+//
+//	"sector" -- the sector wanted
+//	"readIn" -- whether to read the sector, if it isn't cached
+//----------------------------------------------------------------------
+
+Buffer *
+BufferCache::Get(int sector, bool readIn)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Buffer *b;
+
+    ASSERT((sector >= 0) && (sector < NumSectors));
+    for (;;) {
+	b = Find(sector);
+	if (b != NULL) {
+	    if (b->busy) {
+		WaitIdle(b);
+		continue;
+	    }
+	    stats->numCacheHits++;
+	    if (b->prefetched) {
+		stats->numPrefetchHits++;
+		b->prefetched = FALSE;
+	    }
+	    break;
+	}
+
+	for (b = oldest; b != NULL; b = b->newer)
+	    if ((b->pinCount == 0) && !b->busy)
+		break;
+	if (b == NULL) {		// everything is in use
+	    freeWaiters++;
+	    bufferFreed->P();
+	    continue;
+	}
+	if (b->dirty) {
+	    WriteRun(b->sector, SectorsPerTrack - b->sector % SectorsPerTrack);
+	    continue;
+	}
+
+	stats->numCacheMisses++;
+	Rehash(b, sector);
+	b->prefetched = FALSE;
+	if (readIn) {
+	    b->busy = TRUE;
+	    disk->ReadSector(sector, b->data);
+	    MakeIdle(b);
+	}
+	break;
+    }
+    b->pinCount++;
+    Touch(b);
+    (void) interrupt->SetLevel(oldLevel);
+    return b;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Victim
+// 	Return the least recently used buffer that can be reused without
+//	sleeping -- not pinned, not busy and not dirty -- or NULL if there
+//	isn't one.  Called with interrupts off.
+//----------------------------------------------------------------------
+
+Buffer *
+BufferCache::Victim()
+{
+    Buffer *b;
+
+    for (b = oldest; b != NULL; b = b->newer)
+	if ((b->pinCount == 0) && !b->busy && !b->dirty)
+	    return b;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Prefetch
+// 	Start reading a sector into the cache, in the expectation that
+//	someone will ask for it soon.  We return without waiting; the
+//	buffer is busy until the read completes, so anyone who asks for
+//	the sector in the meantime waits for it, as usual.
+//
+//	Reading ahead is only a hint, so we never sleep here: if the
+//	sector is already cached, or the only buffers we could take are
+//	dirty, pinned or busy, we just don't bother.  Nor do we when the
+//	disk is busy already (PrefetchLimit requests outstanding), so
+//	that reading ahead never holds up the requests someone waits on.
+//
+//	"sector" -- the sector to read
+//----------------------------------------------------------------------
+
+void
+BufferCache::Prefetch(int sector)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Buffer *b;
+
+    ASSERT((sector >= 0) && (sector < NumSectors));
+    if ((Find(sector) == NULL) && (disk->NumQueued() < PrefetchLimit)) {
+	b = Victim();
+	if (b != NULL) {
+	    stats->numPrefetches++;
+	    Rehash(b, sector);
+	    Touch(b);
+	    b->busy = TRUE;
+	    b->prefetched = TRUE;
+	    disk->StartRead(sector, b->data, CachePrefetchDone, (int) b);
+	}
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::PrefetchDone
+// 	A read started by Prefetch has finished; let anyone waiting for
+//	the buffer have it.  Called from the disk interrupt handler.
+//----------------------------------------------------------------------
+
+void
+BufferCache::PrefetchDone(Buffer *b)
+{
+    MakeIdle(b);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Find
+// 	Return the buffer holding "sector", or NULL if it isn't cached.
+//----------------------------------------------------------------------
+
+Buffer *
+BufferCache::Find(int sector)
+{
+    Buffer *b;
+
+    for (b = buckets[sector % CacheBuckets]; b != NULL; b = b->hashNext)
+	if (b->sector == sector)
+	    return b;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Rehash
+// 	Move a buffer to the hash bucket for the new sector it will hold.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Rehash(Buffer *b, int sector)
+{
+    Buffer **ptr;
+
+    if (b->sector >= 0) {
+	for (ptr = &buckets[b->sector % CacheBuckets]; *ptr != b;
+						ptr = &(*ptr)->hashNext)
+	    ASSERT(*ptr != NULL);
+	*ptr = b->hashNext;
+    }
+    b->sector = sector;
+    b->hashNext = buckets[sector % CacheBuckets];
+    buckets[sector % CacheBuckets] = b;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Touch
+// 	Move a buffer to the front of the LRU list.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Touch(Buffer *b)
+{
+    if (b == newest)
+	return;
+    b->newer->older = b->older;		// not newest, so b->newer exists
+    if (b->older != NULL)
+	b->older->newer = b->newer;
+    else
+	oldest = b->newer;
+    b->newer = NULL;
+    b->older = newest;
+    newest->newer = b;
+    newest = b;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::WaitIdle/MakeIdle
+// 	Wait for I/O on a buffer to finish; and signal that it has.
+//	Called with interrupts off.
+//----------------------------------------------------------------------
+
+void
+BufferCache::WaitIdle(Buffer *b)
+{
+    b->waiters++;
+    b->idle->P();
+}
+
+void
+BufferCache::MakeIdle(Buffer *b)
+{
+    b->busy = FALSE;
+    for (; b->waiters > 0; b->waiters--)
+	b->idle->V();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::WriteBack
+// 	Write a dirty, unpinned buffer to disk.  Called with interrupts
+//	off; the buffer is busy while we sleep, so no one can change it.
+//----------------------------------------------------------------------
+
+void
+BufferCache::WriteBack(Buffer *b)
+{
+    ASSERT(b->dirty && !b->busy && (b->pinCount == 0));
+    b->busy = TRUE;
+    disk->WriteSector(b->sector, b->data);
+    b->dirty = FALSE;
+    stats->numCacheWritebacks++;
+    MakeIdle(b);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::WriteRun
+// 	Write back the dirty buffers among a run of consecutive sectors.
+//	Each stretch of them that are dirty, and not pinned or busy, goes
+//	to disk with one SynchDisk::WriteSectors, so that the disk writes
+//	them one after another, instead of turning all the way around
+//	between them.
+//
+//	"sector" -- the first sector of the run
+//	"count" -- how many sectors are in it
+//----------------------------------------------------------------------
+
+void
+BufferCache::WriteRun(int sector, int count)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Buffer *run[NumBuffers], *b;
+    int end = sector + count, n, i;
+    char *data;
+
+    if (end > NumSectors)
+	end = NumSectors;
+    while (sector < end) {
+	for (n = 0; sector + n < end; n++) {
+	    b = Find(sector + n);
+	    if ((b == NULL) || !b->dirty || b->busy || (b->pinCount > 0))
+		break;
+	    run[n] = b;
+	}
+	if (n == 0) {
+	    sector++;
+	    continue;
+	}
+	if (n == 1)
+	    WriteBack(run[0]);
+	else {
+	    data = new char[n * SectorSize];
+	    for (i = 0; i < n; i++) {
+		run[i]->busy = TRUE;
+		bcopy(run[i]->data, &data[i * SectorSize], SectorSize);
+	    }
+	    disk->WriteSectors(sector, n, data);
+	    for (i = 0; i < n; i++) {
+		run[i]->dirty = FALSE;
+		stats->numCacheWritebacks++;
+		MakeIdle(run[i]);
+	    }
+	    delete [] data;
+	}
+	sector += n;
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ScheduleFlush
+// 	Arrange for the flusher thread to run FlushDelay ticks from now,
+//	unless it is already going to.  Called with interrupts off.
+//----------------------------------------------------------------------
+
+void
+BufferCache::ScheduleFlush()
+{
+    if (flushScheduled)
+	return;
+    flushScheduled = TRUE;
+    interrupt->Schedule(CacheFlushTimer, (int) this, FlushDelay,
+			CacheFlushInt);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::FlushTimerExpired
+// 	Called from the flush timer interrupt handler; wake the flusher.
+//----------------------------------------------------------------------
+
+void
+BufferCache::FlushTimerExpired()
+{
+    flushScheduled = FALSE;
+    flushWanted->V();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::FlushDirty
+// 	Write back each dirty buffer that no one is using, with the dirty
+//	sectors after it on its track.  Pinned buffers are written once
+//	they are unpinned; if some other thread is busy with a buffer, we
+//	try again later.
+//----------------------------------------------------------------------
+
+void
+BufferCache::FlushDirty()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    bool retry = FALSE;
+
+    for (int i = 0; i < NumBuffers; i++) {
+	Buffer *b = &buffers[i];
+
+	if (!b->dirty || (b->pinCount > 0))
+	    continue;
+	if (b->busy)
+	    retry = TRUE;
+	else
+	    WriteRun(b->sector, SectorsPerTrack - b->sector % SectorsPerTrack);
+    }
+    if (retry)
+	ScheduleFlush();
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Flush
+// 	Write back every dirty buffer that isn't pinned, waiting for any
+//	that are busy.  Called when the file system is shut down.
+//
+//	If Nachos is halting because there is nothing left to do, the
+//	flusher has already written everything it could, and there is no
+//	thread that could wait for the disk, so we don't try.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Flush()
+{
+    IntStatus oldLevel;
+    int i;
+
+    if (interrupt->getStatus() == IdleMode)
+	return;
+    oldLevel = interrupt->SetLevel(IntOff);
+    for (i = 0; i < NumBuffers; i++) {
+	Buffer *b = &buffers[i];
+
+	while (b->busy)
+	    WaitIdle(b);
+	if (b->dirty && (b->pinCount == 0))
+	    WriteBack(b);
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
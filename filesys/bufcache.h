@@ -0,0 +1,127 @@
+// bufcache.h
+//	Data structures for a cache of disk sectors, between the file
+//	system and the synchronous disk.
+//
+//	The cache holds a fixed number of sector-sized buffers.  A read
+//	that finds its sector in the cache never goes to the disk; a write
+//	just changes the cached copy and marks it dirty.  Dirty buffers
+//	are written back by a flusher thread, some time after they are
+//	dirtied, or when their buffer is needed for another sector; dirty
+//	buffers for the sectors that follow on the same track go along,
+//	in the same request.  The least recently used buffer is the one
+//	replaced.
+//
+//	A sector can also be read ahead, before anyone asks for it: the
+//	read is started, but no one waits for it to finish.
+//
+//	A buffer can also be "pinned", to use the cached copy in place
+//	rather than copying it.  A pinned buffer is never replaced or
+//	written back, until it is unpinned.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef BUFCACHE_H
+#define BUFCACHE_H
+
+#include "disk.h"
+#include "synch.h"
+#include "synchdisk.h"
+
+#define NumBuffers	64		// sectors in the cache
+#define CacheBuckets	61		// hash buckets for finding a sector
+#define FlushDelay	20000		// ticks from dirtying a buffer to
+					// writing it back
+#define PrefetchLimit	(MaxDiskRequests / 2)
+					// don't read ahead when this many
+					// requests are outstanding already
+
+// One buffer in the cache.
+class Buffer {
+  public:
+    int sector;				// which sector is cached, or -1
+    char *data;				// the contents of the sector
+    bool dirty;				// modified since read or written?
+    bool busy;				// is the buffer being read/written?
+    bool prefetched;			// read ahead, and not yet asked for?
+    int pinCount;			// how many users have it pinned
+    int waiters;			// threads waiting for it to be idle
+    Semaphore *idle;			// ... and what they wait on
+
+    Buffer *hashNext;			// next buffer in the same bucket
+    Buffer *newer, *older;		// neighbors in the LRU list
+};
+
+// The following class defines the cache.  Like SynchDisk, each
+// operation returns only once it is done, and several threads can
+// use the cache at once.
+class BufferCache {
+  public:
+    BufferCache(SynchDisk *theDisk);	// Initialize the cache, and start
+					// the flusher thread
+    ~BufferCache();			// De-allocate the cache; does NOT
+					// write back dirty buffers
+
+    void ReadSector(int sector, char *data);
+					// Copy a sector out of the cache,
+					// reading it from disk if need be
+    void WriteSector(int sector, char *data);
+					// Copy a sector into the cache, to
+					// be written to disk later
+    void ReadSectors(int sector, int count, char *data);
+					// Copy a run of consecutive sectors;
+					// those not cached are read from
+					// disk a track at a time
+
+    char *Pin(int sector, bool overwrite);
+					// Return the cached copy of a sector,
+					// which stays put until Unpin.  If
+					// "overwrite", the caller will set
+					// all of it, so don't read it in
+    void Unpin(char *data, bool dirtied);
+					// Done with a pinned sector; if
+					// "dirtied", it was modified
+
+    void Prefetch(int sector);		// Start reading a sector into the
+					// cache, if it isn't there and a
+					// clean buffer is free; don't wait
+    void PrefetchDone(Buffer *b);	// A read started by Prefetch is done
+
+    void WriteRun(int sector, int count);
+					// Write back the dirty buffers for
+					// a run of sectors, as few requests
+					// as can be
+    void Flush();			// Write back all dirty buffers
+    void FlushDirty();			// Write back the dirty buffers
+					// that aren't pinned or busy
+    void FlushTimerExpired();		// Time for the flusher to run
+
+    Semaphore *flushWanted;		// the flusher thread waits on this
+
+  private:
+    SynchDisk *disk;			// where sectors come from
+    char *pool;				// the data of all the buffers
+    Buffer buffers[NumBuffers];
+    Buffer *buckets[CacheBuckets];	// hash table, by sector
+    Buffer *newest, *oldest;		// LRU list, most recent first
+    int freeWaiters;			// threads waiting for a buffer to
+    Semaphore *bufferFreed;		// be unpinned, and what they wait on
+    bool flushScheduled;		// is a flush timer pending?
+
+    Buffer *Find(int sector);		// look up a sector, or NULL
+    Buffer *Get(int sector, bool readIn);
+					// find or load a sector, and pin it
+    Buffer *Victim();			// a clean, idle buffer to reuse now,
+					// or NULL
+    void WaitIdle(Buffer *b);		// wait until "b" is not busy
+    void MakeIdle(Buffer *b);		// done with I/O on "b"
+    void Touch(Buffer *b);		// move "b" to the front of the LRU
+    void Rehash(Buffer *b, int sector);	// change the sector "b" holds
+    void WriteBack(Buffer *b);		// write "b" to disk
+    void ScheduleFlush();		// arrange for the flusher to run
+};
+
+#endif // BUFCACHE_H
@@ -0,0 +1,169 @@
+// dcache.cc
+//	Routines to manage the cache of directory entries.  See dcache.h
+//	for an overview.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "dcache.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// DentryCache::DentryCache
+// 	Initialize an empty cache.
+//----------------------------------------------------------------------
+
+DentryCache::DentryCache()
+{
+    int i;
+
+    for (i = 0; i < DentryBuckets; i++)
+	buckets[i] = NULL;
+    for (i = 0; i < NumDentries; i++) {
+	dentries[i].parent = -1;
+	dentries[i].hashNext = NULL;
+	dentries[i].newer = (i > 0) ? &dentries[i - 1] : NULL;
+	dentries[i].older = (i < NumDentries - 1) ? &dentries[i + 1] : NULL;
+    }
+    newest = &dentries[0];
+    oldest = &dentries[NumDentries - 1];
+}
+
+//----------------------------------------------------------------------
+// DentryCache::~DentryCache
+// 	De-allocate the cache.
+//----------------------------------------------------------------------
+
+DentryCache::~DentryCache()
+{
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Lookup
+// 	Return the cache entry for a name in a directory, or NULL if
+//	there isn't one.  The entry's "sector" is -1 if the name is
+//	known not to exist.
+//
+//	"parent" -- the header sector of the directory
+//	"name" -- the name to look up
+//----------------------------------------------------------------------
+
+Dentry *
+DentryCache::Lookup(int parent, char *name)
+{
+    Dentry *d;
+
+    for (d = buckets[Bucket(parent, name)]; d != NULL; d = d->hashNext)
+	if ((d->parent == parent) && !strncmp(d->name, name, FileNameMaxLen)) {
+	    stats->numNameHits++;
+	    Touch(d);
+	    return d;
+	}
+    stats->numNameMisses++;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Enter
+// 	Remember what a name in a directory refers to, replacing what
+//	was remembered before.  If the name is new to the cache, the
+//	least recently used entry is reused.
+//
+//	"parent" -- the header sector of the directory
+//	"name" -- the name
+//	"sector" -- the header sector of the file, or -1 if there is no
+//		such file
+//	"isDirectory" -- is the file a directory?
+//----------------------------------------------------------------------
+
+void
+DentryCache::Enter(int parent, char *name, int sector, bool isDirectory)
+{
+    Dentry *d;
+    int bucket = Bucket(parent, name);
+
+    for (d = buckets[bucket]; d != NULL; d = d->hashNext)
+	if ((d->parent == parent) && !strncmp(d->name, name, FileNameMaxLen))
+	    break;
+    if (d == NULL) {
+	d = oldest;
+	if (d->parent != -1)
+	    Unhash(d);
+	d->parent = parent;
+	strncpy(d->name, name, FileNameMaxLen);
+	d->name[FileNameMaxLen] = '\0';
+	d->hashNext = buckets[bucket];
+	buckets[bucket] = d;
+    }
+    d->sector = sector;
+    d->isDirectory = isDirectory;
+    Touch(d);
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Purge
+// 	Forget every name in a directory.  Called when the directory is
+//	removed, since its header sector may be reused for a new one.
+//
+//	"parent" -- the header sector of the directory
+//----------------------------------------------------------------------
+
+void
+DentryCache::Purge(int parent)
+{
+    for (int i = 0; i < NumDentries; i++)
+	if (dentries[i].parent == parent) {
+	    Unhash(&dentries[i]);
+	    dentries[i].parent = -1;
+	}
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Bucket
+// 	Return the hash bucket for a name in a directory.
+//----------------------------------------------------------------------
+
+int
+DentryCache::Bucket(int parent, char *name)
+{
+    return (HashName(name) + (unsigned) parent) % DentryBuckets;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Unhash
+// 	Take an entry out of its hash bucket.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Unhash(Dentry *d)
+{
+    Dentry **ptr;
+
+    for (ptr = &buckets[Bucket(d->parent, d->name)]; *ptr != d;
+					ptr = &(*ptr)->hashNext)
+	ASSERT(*ptr != NULL);
+    *ptr = d->hashNext;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Touch
+// 	Move an entry to the front of the LRU list.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Touch(Dentry *d)
+{
+    if (d == newest)
+	return;
+    d->newer->older = d->older;		// not newest, so d->newer exists
+    if (d->older != NULL)
+	d->older->newer = d->newer;
+    else
+	oldest = d->newer;
+    d->newer = NULL;
+    d->older = newest;
+    newest->newer = d;
+    newest = d;
+}
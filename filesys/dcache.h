@@ -0,0 +1,70 @@
+// dcache.h
+//	Data structures for a cache of directory entries, to speed up
+//	the lookup of path names.
+//
+//	Each entry of the cache remembers what one name in one directory
+//	refers to: the sector of the file's header, and whether the file
+//	is a directory.  The cache also remembers names that were looked
+//	for and not found ("negative" entries), so that looking for a
+//	missing file again doesn't read the directory again.  The least
+//	recently used entry is the one replaced.
+//
+//	The cache must be kept up to date by whoever changes a directory.
+//
+//      We assume mutual exclusion is provided by the caller.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef DCACHE_H
+#define DCACHE_H
+
+#include "directory.h"
+
+#define NumDentries	64		// names remembered
+#define DentryBuckets	61		// hash buckets for finding a name
+
+// One entry in the cache.
+class Dentry {
+  public:
+    int parent;				// header sector of the directory
+					// holding the name, or -1 if unused
+    char name[FileNameMaxLen + 1];	// the name
+    int sector;				// header sector of the file, or -1
+					// if there is no such file
+    bool isDirectory;			// is the file a directory?
+
+    Dentry *hashNext;			// next entry in the same bucket
+    Dentry *newer, *older;		// neighbors in the LRU list
+};
+
+// The following class defines the cache of directory entries.
+class DentryCache {
+  public:
+    DentryCache();			// Initialize an empty cache
+    ~DentryCache();			// De-allocate the cache
+
+    Dentry *Lookup(int parent, char *name);
+					// What "name" in the directory
+					// "parent" refers to, or NULL if
+					// it is not known
+    void Enter(int parent, char *name, int sector, bool isDirectory);
+					// Remember what a name refers to;
+					// "sector" is -1 if it doesn't exist
+    void Purge(int parent);		// Forget the names in a directory
+					// that has been removed
+
+  private:
+    Dentry dentries[NumDentries];
+    Dentry *buckets[DentryBuckets];	// hash table, by parent and name
+    Dentry *newest, *oldest;		// LRU list, most recent first
+
+    int Bucket(int parent, char *name);	// which bucket a name goes in
+    void Unhash(Dentry *d);		// take "d" out of its bucket
+    void Touch(Dentry *d);		// move "d" to the front of the LRU
+};
+
+#endif // DCACHE_H
@@ -11,10 +11,13 @@
 //	we use ReadFrom/WriteBack to fetch the contents of the directory
 //	from disk, and to write back any modifications back to disk.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
-//	Fixing this is one of the parts to the assignment.
+//	The table is a hash table, using linear probing: a name is
+//	looked for starting at the slot given by its hash, up to the first
+//	slot that has never been used.  So that removing a name doesn't 
+//	cut off the names after it, a removed entry is marked "deleted"
+//	rather than free.  When too many slots are in use or deleted, the
+//	table is rehashed, doubling its size if need be; the directory
+//	file grows to match.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -24,6 +27,22 @@
 #include "utility.h"
 #include "filehdr.h"
 #include "directory.h"
+#include <strings.h>
+
+//----------------------------------------------------------------------
+// HashName
+// 	Return a hash of (at most FileNameMaxLen characters of) a name.
+//----------------------------------------------------------------------
+
+unsigned int
+HashName(char *name)
+{
+    unsigned int hash = 5381;
+
+    for (int i = 0; (i < FileNameMaxLen) && (name[i] != '\0'); i++)
+	hash = hash * 33 + (unsigned char) name[i];
+    return hash;
+}
 
 //----------------------------------------------------------------------
 // Directory::Directory
@@ -32,15 +51,19 @@
 //	is all we need, but otherwise, we need to call FetchFrom in order
 //	to initialize it from disk.
 //
-//	"size" is the number of entries in the directory
+//	"size" is the number of entries in the directory; it is rounded
+//	up to a power of two
 //----------------------------------------------------------------------
 
 Directory::Directory(int size)
 {
-    table = new DirectoryEntry[size];
-    tableSize = size;
-    for (int i = 0; i < tableSize; i++)
-	table[i].inUse = FALSE;
+    for (tableSize = 1; tableSize < size; tableSize *= 2)
+	;
+    table = new DirectoryEntry[tableSize];
+    bzero((char *) table, tableSize * sizeof(DirectoryEntry));
+    numUsed = numDeleted = 0;
+    dirtyFrom = -1;
+    resized = TRUE;			// none of it is on disk yet
 }
 
 //----------------------------------------------------------------------
@@ -55,7 +78,10 @@ Directory::~Directory()
 
 //----------------------------------------------------------------------
 // Directory::FetchFrom
-// 	Read the contents of the directory from disk.
+// 	Read the contents of the directory from disk.  The size of the
+//	table is the largest power of two that fits in the file (if the
+//	disk filled up while the table was growing, the file may be a bit
+//	longer).
 //
 //	"file" -- file containing the directory contents
 //----------------------------------------------------------------------
@@ -63,20 +89,66 @@ Directory::~Directory()
 void
 Directory::FetchFrom(OpenFile *file)
 {
+    int n = file->Length() / sizeof(DirectoryEntry), size;
+
+    for (size = 1; size * 2 <= n; size *= 2)
+	;
+    if (size != tableSize) {
+	delete [] table;
+	table = new DirectoryEntry[size];
+	tableSize = size;
+    }
     (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+
+    numUsed = numDeleted = 0;
+    for (int i = 0; i < tableSize; i++)
+	if (table[i].inUse)
+	    numUsed++;
+	else if (table[i].deleted)
+	    numDeleted++;
+    dirtyFrom = -1;
+    resized = FALSE;
 }
 
 //----------------------------------------------------------------------
 // Directory::WriteBack
-// 	Write any modifications to the directory back to disk
+// 	Write any modifications to the directory back to disk.  Only the
+//	entries that have changed are written, unless the table has been
+//	rehashed.
+//
+//	If the table has grown, the file is first lengthened with empty 
+//	entries, leaving the old table as it was; so if the disk is full,
+//	we can return FALSE without having damaged the directory on disk.
 //
 //	"file" -- file to contain the new directory contents
 //----------------------------------------------------------------------
 
-void
+bool
 Directory::WriteBack(OpenFile *file)
 {
-    (void) file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    int length = tableSize * sizeof(DirectoryEntry);
+    int oldLength = file->Length();
+    char *empty;
+    bool success;
+
+    if (oldLength < length) {
+	empty = new char[length - oldLength];
+	bzero(empty, length - oldLength);
+	success = (file->WriteAt(empty, length - oldLength, oldLength) 
+			== length - oldLength);
+	delete [] empty;
+	if (!success)
+	    return FALSE;
+    }
+    if (resized)
+	(void) file->WriteAt((char *)table, length, 0);
+    else if (dirtyFrom >= 0)
+	(void) file->WriteAt((char *)&table[dirtyFrom], 
+			(dirtyTo - dirtyFrom) * sizeof(DirectoryEntry),
+			dirtyFrom * sizeof(DirectoryEntry));
+    dirtyFrom = -1;
+    resized = FALSE;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -90,9 +162,15 @@ Directory::WriteBack(OpenFile *file)
 int
 Directory::FindIndex(char *name)
 {
-    for (int i = 0; i < tableSize; i++)
+    int i = HashName(name) & (tableSize - 1);
+
+    for (int probes = 0; probes < tableSize; probes++) {
+	if (!table[i].inUse && !table[i].deleted)
+	    break;		// never used, so the name isn't past here
         if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
 	    return i;
+	i = (i + 1) & (tableSize - 1);
+    }
     return -1;		// name not in directory
 }
 
@@ -103,43 +181,80 @@ Directory::FindIndex(char *name)
 //	in the directory.
 //
 //	"name" -- the file name to look up
+//	"isDirectory" -- if not NULL, set to whether the file found is
+//		a directory
 //----------------------------------------------------------------------
 
 int
-Directory::Find(char *name)
+Directory::Find(char *name, bool *isDirectory)
 {
     int i = FindIndex(name);
 
-    if (i != -1)
+    if (i != -1) {
+	if (isDirectory != NULL)
+	    *isDirectory = table[i].isDirectory;
 	return table[i].sector;
+    }
     return -1;
 }
 
+//----------------------------------------------------------------------
+// Directory::SectorAt
+// 	Return the disk sector of the header of the file named by entry
+//	"i" of the table, or -1 if the entry isn't in use (or there is no
+//	such entry).  For going through all of the files in a directory,
+//	with TableSize.
+//
+//	"i" -- the index of the entry
+//	"isDirectory" -- set to whether the file is a directory
+//----------------------------------------------------------------------
+
+int
+Directory::SectorAt(int i, bool *isDirectory)
+{
+    if ((i < 0) || (i >= tableSize) || !table[i].inUse)
+	return -1;
+    *isDirectory = table[i].isDirectory;
+    return table[i].sector;
+}
+
 //----------------------------------------------------------------------
 // Directory::Add
 // 	Add a file into the directory.  Return TRUE if successful;
-//	return FALSE if the file name is already in the directory, or if
-//	the directory is completely full, and has no more space for
-//	additional file names.
+//	return FALSE if the file name is already in the directory.
+//	If the table is getting full, it is rehashed first -- into a
+//	table twice as big, unless it is mostly deleted entries.
 //
 //	"name" -- the name of the file being added
 //	"newSector" -- the disk sector containing the added file's header
+//	"isDirectory" -- is the file a directory?
 //----------------------------------------------------------------------
 
 bool
-Directory::Add(char *name, int newSector)
+Directory::Add(char *name, int newSector, bool isDirectory)
 { 
+    int i;
+
     if (FindIndex(name) != -1)
 	return FALSE;
+    if (numUsed + numDeleted + 1 > MaxDirLoad(tableSize))
+	Resize((numUsed + 1 > MaxDirLoad(tableSize) / 2) ? 
+			tableSize * 2 : tableSize);
 
-    for (int i = 0; i < tableSize; i++)
-        if (!table[i].inUse) {
-            table[i].inUse = TRUE;
-            strncpy(table[i].name, name, FileNameMaxLen); 
-            table[i].sector = newSector;
-        return TRUE;
-	}
-    return FALSE;	// no space.  Fix when we have extensible files.
+    for (i = HashName(name) & (tableSize - 1); table[i].inUse; 
+					i = (i + 1) & (tableSize - 1))
+	;
+    if (table[i].deleted)
+	numDeleted--;
+    table[i].inUse = TRUE;
+    table[i].deleted = FALSE;
+    table[i].isDirectory = isDirectory;
+    strncpy(table[i].name, name, FileNameMaxLen); 
+    table[i].name[FileNameMaxLen] = '\0';
+    table[i].sector = newSector;
+    numUsed++;
+    Changed(i);
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -158,12 +273,65 @@ Directory::Remove(char *name)
     if (i == -1)
 	return FALSE; 		// name not in directory
     table[i].inUse = FALSE;
+    table[i].deleted = TRUE;
+    numUsed--;
+    numDeleted++;
+    Changed(i);
     return TRUE;	
 }
 
+//----------------------------------------------------------------------
+// Directory::Resize
+// 	Rehash the entries in use into a new table, dropping the deleted
+//	ones.
+//
+//	"newSize" -- the size of the new table, a power of two
+//----------------------------------------------------------------------
+
+void
+Directory::Resize(int newSize)
+{
+    DirectoryEntry *oldTable = table;
+    int oldSize = tableSize, i, j;
+
+    DEBUG('f', "Rehashing directory of %d entries into %d\n", oldSize, 
+	  newSize);
+    table = new DirectoryEntry[newSize];
+    tableSize = newSize;
+    bzero((char *) table, tableSize * sizeof(DirectoryEntry));
+    for (i = 0; i < oldSize; i++)
+	if (oldTable[i].inUse) {
+	    for (j = HashName(oldTable[i].name) & (tableSize - 1); 
+			table[j].inUse; j = (j + 1) & (tableSize - 1))
+		;
+	    table[j] = oldTable[i];
+	}
+    delete [] oldTable;
+    numDeleted = 0;
+    resized = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::Changed
+// 	Note that an entry has changed, and must be written back.
+//----------------------------------------------------------------------
+
+void
+Directory::Changed(int i)
+{
+    if (dirtyFrom < 0) {
+	dirtyFrom = i;
+	dirtyTo = i + 1;
+    } else if (i < dirtyFrom)
+	dirtyFrom = i;
+    else if (i >= dirtyTo)
+	dirtyTo = i + 1;
+}
+
 //----------------------------------------------------------------------
 // Directory::List
-// 	List all the file names in the directory. 
+// 	List all the file names in the directory; the names of 
+//	directories end in a "/".
 //----------------------------------------------------------------------
 
 void
@@ -171,7 +339,8 @@ Directory::List()
 {
    for (int i = 0; i < tableSize; i++)
 	if (table[i].inUse)
-	    printf("%s\n", table[i].name);
+	    printf("%s%s\n", table[i].name, 
+			table[i].isDirectory ? "/" : "");
 }
 
 //----------------------------------------------------------------------
@@ -188,7 +357,8 @@ Directory::Print()
     printf("Directory contents:\n");
     for (int i = 0; i < tableSize; i++)
 	if (table[i].inUse) {
-	    printf("Name: %s, Sector: %d\n", table[i].name, table[i].sector);
+	    printf("Name: %s%s, Sector: %d\n", table[i].name, 
+			table[i].isDirectory ? "/" : "", table[i].sector);
 	    hdr->FetchFrom(table[i].sector);
 	    hdr->Print();
 	}
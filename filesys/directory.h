@@ -4,7 +4,8 @@
 //      A directory is a table of pairs: <file name, sector #>,
 //	giving the name of each file in the directory, and 
 //	where to find its file header (the data structure describing
-//	where to find the file's data blocks) on disk.
+//	where to find the file's data blocks) on disk.  An entry can
+//	also name another directory, so that directories form a tree.
 //
 //      We assume mutual exclusion is provided by the caller.
 //
@@ -19,8 +20,14 @@
 
 #include "openfile.h"
 
-#define FileNameMaxLen 		9	// for simplicity, we assume 
-					// file names are <= 9 characters long
+#define FileNameMaxLen 		23	// for simplicity, we assume 
+					// file names are <= 23 characters long,
+					// so that an entry is 32 bytes
+#define MaxDirLoad(size)	((size) * 3 / 4)
+					// how many entries, in use or 
+					// deleted, before the table grows
+
+extern unsigned int HashName(char *name);	// hash of a file name
 
 // The following class defines a "directory entry", representing a file
 // in the directory.  Each entry gives the name of the file, and where
@@ -32,6 +39,9 @@
 class DirectoryEntry {
   public:
     bool inUse;				// Is this directory entry in use?
+    bool deleted;			// Was it in use, once?  Lookups must
+					// keep looking past such entries
+    bool isDirectory;			// Is the file itself a directory?
     int sector;				// Location on disk to find the 
 					//   FileHeader for this file 
     char name[FileNameMaxLen + 1];	// Text name for file, with +1 for 
@@ -44,9 +54,14 @@ class DirectoryEntry {
 // The directory data structure can be stored in memory, or on disk.
 // When it is on disk, it is stored as a regular Nachos file.
 //
+// The entries form a hash table, so that a name can be found without 
+// looking at every entry: a name's entry is at the slot its hash
+// picks, or at one of the slots after that one (wrapping around).  The
+// table is a power of two in size, and doubles when it gets too full.
+//
 // The constructor initializes a directory structure in memory; the
 // FetchFrom/WriteBack operations shuffle the directory information
-// from/to disk. 
+// from/to disk.  WriteBack only writes the entries that have changed.
 
 class Directory {
   public:
@@ -55,16 +70,30 @@ class Directory {
     ~Directory();			// De-allocate the directory
 
     void FetchFrom(OpenFile *file);  	// Init directory contents from disk
-    void WriteBack(OpenFile *file);	// Write modifications to 
-					// directory contents back to disk
+    bool WriteBack(OpenFile *file);	// Write modifications to 
+					// directory contents back to disk;
+					// FALSE if the disk is too full
 
-    int Find(char *name);		// Find the sector number of the 
-					// FileHeader for file: "name"
+    int Find(char *name, bool *isDirectory = NULL);
+    					// Find the sector number of the 
+					// FileHeader for file: "name", and
+					// whether it is a directory
 
-    bool Add(char *name, int newSector);  // Add a file name into the directory
+    bool Add(char *name, int newSector, bool isDirectory = FALSE);
+    					// Add a file name into the directory
+
+    bool IsEmpty() { return numUsed == 0; }
+    					// Are there no files in it?
 
     bool Remove(char *name);		// Remove a file from the directory
 
+    int TableSize() { return tableSize; }
+					// Number of entries, to go through
+					// with SectorAt
+    int SectorAt(int i, bool *isDirectory);
+					// The header sector entry "i" names,
+					// or -1 if it isn't in use
+
     void List();			// Print the names of all the files
 					//  in the directory
     void Print();			// Verbose print of the contents
@@ -75,9 +104,16 @@ class Directory {
     int tableSize;			// Number of directory entries
     DirectoryEntry *table;		// Table of pairs: 
 					// <file name, file header location> 
+    int numUsed;			// Entries in use
+    int numDeleted;			// Entries once used, and not since
+    int dirtyFrom, dirtyTo;		// Entries changed since the last
+					// WriteBack, or dirtyFrom == -1
+    bool resized;			// The whole table has changed
 
     int FindIndex(char *name);		// Find the index into the directory 
 					//  table corresponding to "name"
+    void Resize(int newSize);		// Rehash into a table of "newSize"
+    void Changed(int i);		// Note that entry "i" has changed
 };
 
 #endif // DIRECTORY_H
@@ -3,12 +3,13 @@
 //	would be called the i-node).
 //
 //	The file header is used to locate where on disk the 
-//	file's data is stored.  We implement this as a fixed size
-//	table of pointers -- each entry in the table points to the 
-//	disk sector containing that portion of the file data
-//	(in other words, there are no indirect or doubly indirect 
-//	blocks). The table size is chosen so that the file header
-//	will be just big enough to fit in one disk sector, 
+//	file's data is stored.  We implement this as a table of extents
+//	-- each entry in the table gives a run of consecutive disk
+//	sectors containing that portion of the file data.  The first few
+//	extents are in the file header's own sector; the rest are in
+//	single and double indirect blocks.  A file small enough to fit
+//	in the space of the extents has no data sectors; its data is kept
+//	in the header instead.
 //
 //      Unlike in a real system, we do not keep track of file permissions, 
 //	ownership, last modification date, etc., in the file header. 
@@ -18,6 +19,7 @@
 //	     to point to the newly allocated data blocks
 //	   for a file already on disk, by reading the file header from disk
 //
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -26,34 +28,66 @@
 
 #include "system.h"
 #include "filehdr.h"
+#include <strings.h>
+
+//----------------------------------------------------------------------
+// FileHeader::FileHeader
+// 	Initialize an empty file header: no data, and no extents.
+//----------------------------------------------------------------------
+
+FileHeader::FileHeader()
+{
+    numBytes = numSectors = numExtents = 0;
+    maxExtents = NumDirect;
+    extents = new Extent[maxExtents];
+    singleIndirect = doubleIndirect = -1;
+    for (int i = 0; i < BlocksPerBlock; i++)
+	indirect[i] = -1;
+    hintExtent = hintFirst = 0;
+    bzero(inlineData, InlineSize);
+    numReplaced = 0;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::~FileHeader
+// 	De-allocate the in-memory table of extents.
+//----------------------------------------------------------------------
+
+FileHeader::~FileHeader()
+{
+    delete [] extents;
+}
 
 //----------------------------------------------------------------------
 // FileHeader::Allocate
 // 	Initialize a fresh file header for a newly created file.
 //	Allocate data blocks for the file out of the map of free disk blocks.
 //	Return FALSE if there are not enough free blocks to accomodate
-//	the new file.
+//	the new file.  A file that fits in the header gets no blocks.
 //
 //	"freeMap" is the bit map of free disk sectors
-//	"fileSize" is the bit map of free disk sectors
+//	"fileSize" is the number of bytes in the file
+//	"hint" is where to look for free blocks first, or -1 (see Extend)
 //----------------------------------------------------------------------
 
 bool
-FileHeader::Allocate(BitMap *freeMap, int fileSize)
+FileHeader::Allocate(BitMap *freeMap, int fileSize, int hint)
 { 
-    numBytes = fileSize;
-    numSectors  = divRoundUp(fileSize, SectorSize);
-    if (freeMap->NumClear() < numSectors)
+    numBytes = 0;
+    if (fileSize <= InlineSize) {
+	numBytes = fileSize;		// all zero, to start
+	return TRUE;
+    }
+    if (!Extend(freeMap, divRoundUp(fileSize, SectorSize), hint))
 	return FALSE;		// not enough space
-
-    for (int i = 0; i < numSectors; i++)
-	dataSectors[i] = freeMap->Find();
+    numBytes = fileSize;
     return TRUE;
 }
 
 //----------------------------------------------------------------------
 // FileHeader::Deallocate
-// 	De-allocate all the space allocated for data blocks for this file.
+// 	De-allocate all the space allocated for data blocks for this file,
+//	and for its indirect blocks.
 //
 //	"freeMap" is the bit map of free disk sectors
 //----------------------------------------------------------------------
@@ -61,15 +95,300 @@ FileHeader::Allocate(BitMap *freeMap, int fileSize)
 void 
 FileHeader::Deallocate(BitMap *freeMap)
 {
-    for (int i = 0; i < numSectors; i++) {
-	ASSERT(freeMap->Test((int) dataSectors[i]));  // ought to be marked!
-	freeMap->Clear((int) dataSectors[i]);
+    Truncate(freeMap, 0);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Extend
+// 	Add "count" data sectors to the end of the file, and any indirect
+//	blocks needed to keep track of them.  The length of the file is
+//	not changed.  If there isn't enough space, return FALSE, having 
+//	changed nothing.
+//
+//	The sectors are taken in runs of consecutive sectors where
+//	possible, so that the file can be read a track at a time, and
+//	has few extents.  First we take any free sectors that directly
+//	follow the end of the file.  Then we look, starting from the end
+//	of the file, for a run as long as what is still needed (kept 
+//	within a track, if it fits in one), and if there isn't one, for 
+//	runs half as long, and so on.
+//
+//	If a "hint" is given, we look there instead of at the end of the
+//	file, and only take the sectors after the end of the file if
+//	they are the ones at "hint".
+//
+//	If the file's data was kept in the header, it is moved to the
+//	first of the new sectors.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"count" is the number of sectors to add
+//	"hint" is where to look for free sectors first, or -1
+//----------------------------------------------------------------------
+
+bool
+FileHeader::Extend(BitMap *freeMap, int count, int hint)
+{
+    int oldSectors = numSectors;
+    int wanted = numSectors + count;
+    int run, first;
+    char *data;
+
+    if (numExtents > 0) {
+	first = extents[numExtents - 1].start + extents[numExtents - 1].length;
+	if (hint < 0)
+	    hint = first;
+	else if (hint != first)
+	    first = NumSectors;		// don't continue the file here
+	for (run = 0; (numSectors + run < wanted) 
+		&& (first + run < NumSectors) && !freeMap->Test(first + run);
+		run++)
+	    freeMap->Mark(first + run);
+	if (run > 0) {
+	    AddExtent(first, run);
+	    numSectors += run;
+	}
+    }
+    run = wanted - numSectors;
+    while (numSectors < wanted) {
+	if (run > wanted - numSectors)
+	    run = wanted - numSectors;
+	first = freeMap->FindRun(run, 
+		    (run <= SectorsPerTrack) ? SectorsPerTrack : NumSectors,
+		    hint);
+	if (first >= 0) {
+	    AddExtent(first, run);
+	    numSectors += run;
+	} else if (run > 1)
+	    run /= 2;
+	else
+	    break;			// the disk is full
+    }
+    if ((numSectors < wanted) || (numExtents > MaxExtents) 
+		|| !AllocateIndex(freeMap)) {
+	Truncate(freeMap, oldSectors);
+	return FALSE;
+    }
+    if ((oldSectors == 0) && (numSectors > 0) && (numBytes > 0)) {
+	data = bufferCache->Pin(extents[0].start, TRUE);
+	bcopy(inlineData, data, numBytes);
+	bzero(&data[numBytes], SectorSize - numBytes);
+	bufferCache->Unpin(data, TRUE);
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SectorsNeeded
+// 	Return how many sectors must be added to the file for it to be
+//	"length" bytes long; none, if it has room already.  A file kept
+//	in its header needs sectors for all of its data.
+//----------------------------------------------------------------------
+
+int
+FileHeader::SectorsNeeded(int length)
+{
+    if (length <= SpaceLength())
+	return 0;
+    return divRoundUp(length, SectorSize) - numSectors;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Trim
+// 	Free the sectors allocated beyond the end of the file's data.
+//
+//	"freeMap" is the bit map of free disk sectors
+//----------------------------------------------------------------------
+
+void
+FileHeader::Trim(BitMap *freeMap)
+{
+    Truncate(freeMap, divRoundUp(numBytes, SectorSize));
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Replace
+// 	Move one of the file's data sectors to "newSector", which the
+//	caller has allocated (and will fill in).  The extent holding the
+//	old sector is split around it; the new sector joins the extent
+//	before or after it, if it continues one of them.  The old sector
+//	is kept, to be freed by FreeReplaced.
+//
+//	Return FALSE, having changed nothing, if too many sectors are
+//	waiting to be freed already, or there is no room for the extents.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"fileSector" is which sector of the file to move
+//	"newSector" is where it goes
+//----------------------------------------------------------------------
+
+bool
+FileHeader::Replace(BitMap *freeMap, int fileSector, int newSector)
+{
+    Extent *old = extents;
+    int oldCount = numExtents, oldMax = maxExtents;
+    int i, first = 0, offset, after;
+
+    ASSERT((fileSector >= 0) && (fileSector < numSectors));
+    if (numReplaced == MaxReplaced)
+	return FALSE;
+    for (i = 0; first + old[i].length <= fileSector; i++)
+	first += old[i].length;
+    offset = fileSector - first;
+    after = old[i].length - offset - 1;
+
+    extents = new Extent[maxExtents];	// AddExtent joins the pieces up
+    numExtents = 0;
+    for (int j = 0; j < oldCount; j++) {
+	if (j != i) {
+	    AddExtent(old[j].start, old[j].length);
+	    continue;
+	}
+	if (offset > 0)
+	    AddExtent(old[i].start, offset);
+	AddExtent(newSector, 1);
+	if (after > 0)
+	    AddExtent(old[i].start + offset + 1, after);
+    }
+    if ((numExtents > MaxExtents) || !AllocateIndex(freeMap)) {
+	delete [] extents;
+	extents = old;
+	numExtents = oldCount;
+	maxExtents = oldMax;
+	return FALSE;
+    }
+    replaced[numReplaced++] = old[i].start + offset;
+    delete [] old;
+    hintExtent = hintFirst = 0;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FreeReplaced
+// 	Free the sectors that data was moved from by Replace.  Call this
+//	only when the header is being written back, in the same journal
+//	transaction.
+//
+//	"freeMap" is the bit map of free disk sectors
+//----------------------------------------------------------------------
+
+void
+FileHeader::FreeReplaced(BitMap *freeMap)
+{
+    for (int i = 0; i < numReplaced; i++) {
+	ASSERT(freeMap->Test(replaced[i]));
+	freeMap->Clear(replaced[i]);
+    }
+    numReplaced = 0;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AddExtent
+// 	Add a run of sectors to the end of the file's table of extents.
+//	If it continues the last extent, just make that longer.  Doesn't
+//	change numSectors.
+//----------------------------------------------------------------------
+
+void
+FileHeader::AddExtent(int start, int length)
+{
+    Extent *bigger;
+
+    if ((numExtents > 0) && (extents[numExtents - 1].start 
+			+ extents[numExtents - 1].length == start)) {
+	extents[numExtents - 1].length += length;
+	return;
+    }
+    if (numExtents == maxExtents) {
+	bigger = new Extent[maxExtents * 2];
+	bcopy(extents, bigger, numExtents * sizeof(Extent));
+	delete [] extents;
+	extents = bigger;
+	maxExtents *= 2;
+    }
+    extents[numExtents].start = start;
+    extents[numExtents].length = length;
+    numExtents++;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AllocateIndex
+// 	Allocate whichever indirect blocks the file's extents need and
+//	doesn't have yet.  Return FALSE if we run out of space.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::AllocateIndex(BitMap *freeMap)
+{
+    int numIndirect = 0;
+
+    if (numExtents > NumDirect + ExtentsPerBlock)
+	numIndirect = divRoundUp(numExtents - NumDirect - ExtentsPerBlock,
+				 ExtentsPerBlock);
+    if ((numExtents > NumDirect) && (singleIndirect < 0)
+		&& ((singleIndirect = freeMap->Find()) < 0))
+	return FALSE;
+    if ((numIndirect > 0) && (doubleIndirect < 0)
+		&& ((doubleIndirect = freeMap->Find()) < 0))
+	return FALSE;
+    for (int i = 0; i < numIndirect; i++)
+	if ((indirect[i] < 0) && ((indirect[i] = freeMap->Find()) < 0))
+	    return FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Truncate
+// 	Free the data sectors after the first "count", and the indirect
+//	blocks that are then no longer needed, revoking them in the
+//	journal in case they were logged.
+//----------------------------------------------------------------------
+
+void
+FileHeader::Truncate(BitMap *freeMap, int count)
+{
+    Extent *last;
+    int i, numIndirect = 0;
+
+    while (numSectors > count) {
+	last = &extents[numExtents - 1];
+	for (; (last->length > 0) && (numSectors > count); numSectors--) {
+	    last->length--;
+	    ASSERT(freeMap->Test(last->start + last->length));  // ought to be marked!
+	    freeMap->Clear(last->start + last->length);
+	    journal->Revoke(last->start + last->length);
+	}
+	if (last->length == 0)
+	    numExtents--;
+    }
+    if ((numSectors > 0) && (numBytes > numSectors * SectorSize))
+	numBytes = numSectors * SectorSize;
+
+    if (numExtents > NumDirect + ExtentsPerBlock)
+	numIndirect = divRoundUp(numExtents - NumDirect - ExtentsPerBlock,
+				 ExtentsPerBlock);
+    for (i = numIndirect; i < BlocksPerBlock; i++)
+	if (indirect[i] >= 0) {
+	    freeMap->Clear(indirect[i]);
+	    journal->Revoke(indirect[i]);
+	    indirect[i] = -1;
+	}
+    if ((numIndirect == 0) && (doubleIndirect >= 0)) {
+	freeMap->Clear(doubleIndirect);
+	journal->Revoke(doubleIndirect);
+	doubleIndirect = -1;
     }
+    if ((numExtents <= NumDirect) && (singleIndirect >= 0)) {
+	freeMap->Clear(singleIndirect);
+	journal->Revoke(singleIndirect);
+	singleIndirect = -1;
+    }
+    hintExtent = hintFirst = 0;
 }
 
 //----------------------------------------------------------------------
 // FileHeader::FetchFrom
-// 	Fetch contents of file header from disk. 
+// 	Fetch contents of file header from disk, along with its indirect
+//	blocks.
 //
 //	"sector" is the disk sector containing the file header
 //----------------------------------------------------------------------
@@ -77,12 +396,49 @@ FileHeader::Deallocate(BitMap *freeMap)
 void
 FileHeader::FetchFrom(int sector)
 {
-    synchDisk->ReadSector(sector, (char *)this);
+    RawFileHeader *raw = (RawFileHeader *) bufferCache->Pin(sector, FALSE);
+    Extent block[ExtentsPerBlock];
+    int i, n;
+
+    numBytes = raw->numBytes;
+    numSectors = raw->numSectors;
+    numExtents = raw->numExtents;
+    for (i = 0; i < BlocksPerBlock; i++)
+	indirect[i] = -1;
+    hintExtent = hintFirst = 0;
+    if (numSectors == 0) {			// the data is right here
+	numExtents = 0;
+	singleIndirect = doubleIndirect = -1;
+	bcopy(raw->u.data, inlineData, InlineSize);
+	bufferCache->Unpin((char *) raw, FALSE);
+	return;
+    }
+    singleIndirect = raw->u.map.singleIndirect;
+    doubleIndirect = raw->u.map.doubleIndirect;
+    if (numExtents > maxExtents) {
+	delete [] extents;
+	maxExtents = numExtents;
+	extents = new Extent[maxExtents];
+    }
+    n = (numExtents < NumDirect) ? numExtents : NumDirect;
+    bcopy(raw->u.map.direct, extents, n * sizeof(Extent));
+    bufferCache->Unpin((char *) raw, FALSE);
+
+    if (doubleIndirect >= 0)
+	bufferCache->ReadSector(doubleIndirect, (char *) indirect);
+    for (i = -1; n < numExtents; i++, n += ExtentsPerBlock) {
+	bufferCache->ReadSector((i < 0) ? singleIndirect : indirect[i],
+				(char *) block);
+	bcopy(block, &extents[n], ((numExtents - n < ExtentsPerBlock) ?
+			numExtents - n : ExtentsPerBlock) * sizeof(Extent));
+    }
 }
 
 //----------------------------------------------------------------------
 // FileHeader::WriteBack
-// 	Write the modified contents of the file header back to disk. 
+// 	Write the modified contents of the file header back to disk,
+//	along with its indirect blocks -- in the current transaction, if
+//	there is one (see journal.h).
 //
 //	"sector" is the disk sector to contain the file header
 //----------------------------------------------------------------------
@@ -90,7 +446,40 @@ FileHeader::FetchFrom(int sector)
 void
 FileHeader::WriteBack(int sector)
 {
-    synchDisk->WriteSector(sector, (char *)this); 
+    RawFileHeader *raw;
+    Extent block[ExtentsPerBlock];
+    int i, n;
+
+    journal->Log(sector, TRUE);
+    raw = (RawFileHeader *) bufferCache->Pin(sector, TRUE);
+    ASSERT(sizeof(RawFileHeader) <= SectorSize);
+    bzero((char *) raw, SectorSize);
+    raw->numBytes = numBytes;
+    raw->numSectors = numSectors;
+    raw->numExtents = numExtents;
+    if (numSectors == 0) {			// the data goes right here
+	bcopy(inlineData, raw->u.data, InlineSize);
+	bufferCache->Unpin((char *) raw, TRUE);
+	return;
+    }
+    raw->u.map.singleIndirect = singleIndirect;
+    raw->u.map.doubleIndirect = doubleIndirect;
+    n = (numExtents < NumDirect) ? numExtents : NumDirect;
+    bcopy(extents, raw->u.map.direct, n * sizeof(Extent));
+    bufferCache->Unpin((char *) raw, TRUE);
+
+    if (doubleIndirect >= 0) {
+	journal->Log(doubleIndirect, TRUE);
+	bufferCache->WriteSector(doubleIndirect, (char *) indirect);
+    }
+    for (i = -1; n < numExtents; i++, n += ExtentsPerBlock) {
+	bzero((char *) block, sizeof(block));
+	bcopy(&extents[n], block, ((numExtents - n < ExtentsPerBlock) ?
+			numExtents - n : ExtentsPerBlock) * sizeof(Extent));
+	journal->Log((i < 0) ? singleIndirect : indirect[i], TRUE);
+	bufferCache->WriteSector((i < 0) ? singleIndirect : indirect[i],
+				 (char *) block);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -106,7 +495,60 @@ FileHeader::WriteBack(int sector)
 int
 FileHeader::ByteToSector(int offset)
 {
-    return(dataSectors[offset / SectorSize]);
+    int runLength;
+
+    return ByteToRun(offset, &runLength);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ByteToRun
+// 	Return which disk sector is storing a particular byte within the 
+//	file, and how many sectors from there on are consecutive on disk
+//	(to the end of the extent).
+//
+//	The search starts from the extent found last time, since files
+//	are mostly read in order; a file has few extents in any case.
+//
+//	"offset" is the location within the file of the byte in question
+//	"runLength" is set to the number of consecutive sectors
+//----------------------------------------------------------------------
+
+int
+FileHeader::ByteToRun(int offset, int *runLength)
+{
+    int fileSector = offset / SectorSize;
+
+    ASSERT((offset >= 0) && (fileSector < numSectors));
+    if (fileSector < hintFirst)
+	hintExtent = hintFirst = 0;		// start again at the beginning
+    while (fileSector >= hintFirst + extents[hintExtent].length) {
+	hintFirst += extents[hintExtent].length;
+	hintExtent++;
+    }
+    *runLength = extents[hintExtent].length - (fileSector - hintFirst);
+    return extents[hintExtent].start + (fileSector - hintFirst);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SectorToFile
+// 	Return which sector of the file a disk sector holds, or -1 if it
+//	isn't one of the file's data sectors.
+//
+//	"sector" is the disk sector
+//----------------------------------------------------------------------
+
+int
+FileHeader::SectorToFile(int sector)
+{
+    int first = 0;
+
+    for (int i = 0; i < numExtents; i++) {
+	if ((sector >= extents[i].start) 
+		&& (sector < extents[i].start + extents[i].length))
+	    return first + sector - extents[i].start;
+	first += extents[i].length;
+    }
+    return -1;
 }
 
 //----------------------------------------------------------------------
@@ -120,6 +562,19 @@ FileHeader::FileLength()
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// FileHeader::SetLength
+// 	Change the number of bytes in the file.  The file must already
+//	have enough sectors allocated; see Extend.
+//----------------------------------------------------------------------
+
+void
+FileHeader::SetLength(int length)
+{
+    ASSERT((length >= 0) && (length <= SpaceLength()));
+    numBytes = length;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Print
 // 	Print the contents of the file header, and the contents of all
@@ -133,11 +588,23 @@ FileHeader::Print()
     char *data = new char[SectorSize];
 
     printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
-    for (i = 0; i < numSectors; i++)
-	printf("%d ", dataSectors[i]);
+    for (i = 0; i < numExtents; i++)
+	printf("%d-%d ", extents[i].start, 
+		extents[i].start + extents[i].length - 1);
+    if (singleIndirect >= 0)
+	printf("(indirect %d", singleIndirect);
+    if (doubleIndirect >= 0)
+	printf(", double indirect %d", doubleIndirect);
+    if (singleIndirect >= 0)
+	printf(")");
+    if (numSectors == 0)
+	printf("(in the header)");
     printf("\nFile contents:\n");
-    for (i = k = 0; i < numSectors; i++) {
-	synchDisk->ReadSector(dataSectors[i], data);
+    if (numSectors == 0)
+	bcopy(inlineData, data, numBytes);
+    for (i = k = 0; (i < numSectors) || (k < numBytes); i++) {
+	if (numSectors > 0)
+	    bufferCache->ReadSector(ByteToSector(i * SectorSize), data);
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
 	    if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
 		printf("%c", data[j]);
@@ -17,31 +17,97 @@
 #include "disk.h"
 #include "bitmap.h"
 
-#define NumDirect 	((SectorSize - 2 * sizeof(int)) / sizeof(int))
-#define MaxFileSize 	(NumDirect * SectorSize)
+// A run of consecutive disk sectors, holding consecutive data of a file.
+class Extent {
+  public:
+    int start;				// the first sector of the run
+    int length;				// # of sectors in the run
+};
+
+#define NumDirect 	13		// extents in the header itself
+#define ExtentsPerBlock	((int) (SectorSize / sizeof(Extent)))
+					// extents in an indirect block
+#define BlocksPerBlock	((int) (SectorSize / sizeof(int)))
+					// indirect blocks listed by the
+					// double indirect block
+#define MaxExtents	(NumDirect + ExtentsPerBlock \
+				+ BlocksPerBlock * ExtentsPerBlock)
+#define MaxFileSize 	(NumSectors * SectorSize)
+#define InlineSize	((int) (NumDirect * sizeof(Extent) + 2 * sizeof(int)))
+					// bytes of data that fit in the
+					// header, in place of the extents
+#define MaxReplaced	SectorsPerTrack	// sectors moved (see Replace) before
+					// the header must be written back
+
+// How a file header is laid out in its sector on disk.
+class RawFileHeader {
+  public:
+    int numBytes;			// Number of bytes in the file
+    int numSectors;			// Number of data sectors in the file
+    int numExtents;			// Number of extents in the file
+    union {
+	struct {
+	    Extent direct[NumDirect];	// The first NumDirect extents
+	    int singleIndirect;		// Sector holding the next
+					// ExtentsPerBlock extents, or -1
+	    int doubleIndirect;		// Sector listing the sectors that
+					// hold the rest, or -1
+	} map;				// If there are data sectors
+	char data[InlineSize];		// If not: the data itself
+    } u;
+};
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
-// The file header is organized as a simple table of pointers to
-// data blocks. 
+// The file header is organized as a table of extents -- runs of
+// consecutive data sectors -- in the order they appear in the file.
 //
-// The file header data structure can be stored in memory or on disk.
-// When it is on disk, it is stored in a single sector -- this means
-// that we assume the size of this data structure to be the same
-// as one disk sector.  Without indirect addressing, this
-// limits the maximum file length to just under 4K bytes.
+// When it is on disk, the file header is stored in a single sector,
+// which holds the file's first NumDirect extents.  If there are more,
+// the header points to a "single indirect" sector of further extents,
+// and then to a "double indirect" sector, which lists more sectors of
+// extents.  Since sectors are allocated in long runs, a file usually
+// has only a few extents, however large it is.
 //
-// There is no constructor; rather the file header can be initialized
-// by allocating blocks for the file (if it is a new file), or by
-// reading it from disk.
+// A small file -- no longer than InlineSize bytes -- has no data
+// sectors at all: its data is kept in the header sector, where the
+// extents would go.  When it grows past that, the data is moved to the
+// file's first data sector.
+//
+// A data sector can also be moved to a new place on disk (when the file
+// system writes in log-structured mode, cf. segment.h).  The old sector
+// stays allocated until the header that no longer points to it has been
+// written back, so that a crash in between leaves the file as it was.
+//
+// In memory, the file header keeps the whole table of extents (or the
+// data of a small file).  The file header can be initialized by 
+// allocating blocks for the file (if it is a new file), or by reading
+// it from disk.
 
 class FileHeader {
   public:
-    bool Allocate(BitMap *bitMap, int fileSize);// Initialize a file header, 
+    FileHeader();			// An empty file header
+    ~FileHeader();
+
+    bool Allocate(BitMap *bitMap, int fileSize, int hint = -1);
+						// Initialize a file header, 
 						//  including allocating space 
 						//  on disk for the file data
     void Deallocate(BitMap *bitMap);  		// De-allocate this file's 
-						//  data blocks
+						//  data and indirect blocks
+    bool Extend(BitMap *freeMap, int count, int hint = -1);
+						// Add "count" sectors to
+						//  the end of the file, near
+						//  "hint" if it is given
+    void Trim(BitMap *freeMap);			// Free the sectors past
+						//  the end of the data
+    bool Replace(BitMap *freeMap, int fileSector, int newSector);
+						// Move a data sector to
+						//  "newSector"
+    void FreeReplaced(BitMap *freeMap);		// Free the sectors moved
+						//  from, once the header is
+						//  written back
+    int NumReplaced() { return numReplaced; }	// How many are waiting
 
     void FetchFrom(int sectorNumber); 	// Initialize file header from disk
     void WriteBack(int sectorNumber); 	// Write modifications to file header
@@ -50,17 +116,59 @@ class FileHeader {
     int ByteToSector(int offset);	// Convert a byte offset into the file
 					// to the disk sector containing
 					// the byte
+    int ByteToRun(int offset, int *runLength);
+    					// Ditto, and set "runLength" to the
+					// # of consecutive sectors, in the
+					// same extent, starting there
+    int SectorToFile(int sector);	// Which sector of the file a disk
+					// sector is, or -1 if not the file's
 
     int FileLength();			// Return the length of the file 
 					// in bytes
+    void SetLength(int length);		// Change it, within the sectors
+					// allocated
+    int SpaceLength() 
+	{ return (numSectors == 0) ? InlineSize : numSectors * SectorSize; }
+					// Bytes the file can grow to without
+					// allocating more sectors
+    int SectorsNeeded(int length);	// # of sectors to add to the file
+					// for it to be "length" bytes long
+    int NumDataSectors() { return numSectors; }
+					// # of data sectors the file has
+
+    bool IsInline() { return numSectors == 0; }
+					// Is the data kept in the header?
+    char *InlineData() { return inlineData; }
+					// If so, here it is
 
     void Print();			// Print the contents of the file.
 
   private:
     int numBytes;			// Number of bytes in the file
     int numSectors;			// Number of data sectors in the file
-    int dataSectors[NumDirect];		// Disk sector numbers for each data 
-					// block in the file
+    int numExtents;			// Number of extents in the file
+    Extent *extents;			// All of the extents, in file order
+    int maxExtents;			// how many "extents" can hold
+    int singleIndirect;			// Where the indirect blocks are on
+    int doubleIndirect;			// disk, or -1 (see RawFileHeader)
+    int indirect[BlocksPerBlock];	// Sectors listed by doubleIndirect
+
+    int hintExtent;			// The extent ByteToSector last found,
+    int hintFirst;			// and the # of its first file sector
+
+    char inlineData[InlineSize];	// The data, if there are no sectors
+
+    int replaced[MaxReplaced];		// Sectors moved from, to be freed
+    int numReplaced;			// when the header is written back
+
+    void AddExtent(int start, int length);
+					// add a run of sectors to the end
+    bool AllocateIndex(BitMap *freeMap);
+					// get the indirect blocks needed
+    void Truncate(BitMap *freeMap, int count);
+					// free all but the first "count"
+					// sectors, and any indirect blocks
+					// no longer needed
 };
 
 #endif // FILEHDR_H
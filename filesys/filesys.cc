@@ -7,37 +7,55 @@
 //		(the size of the file header data structure is arranged
 //		to be precisely the size of 1 disk sector)
 //	   A number of data blocks
-//	   An entry in the file system directory
+//	   An entry in a directory
 //
 // 	The file system consists of several data structures:
 //	   A bitmap of free disk sectors (cf. bitmap.h)
-//	   A directory of file names and file headers
+//	   A tree of directories of file names and file headers, starting
+//	     at the root directory
 //
-//      Both the bitmap and the directory are represented as normal
-//	files.  Their file headers are located in specific sectors
-//	(sector 0 and sector 1), so that the file system can find them 
-//	on bootup.
+//      Both the bitmap and the directories are represented as normal
+//	files.  The file headers of the bitmap and the root directory are 
+//	located in specific sectors (sector 0 and sector 1), so that the 
+//	file system can find them on bootup.
 //
-//	The file system assumes that the bitmap and directory files are
-//	kept "open" continuously while Nachos is running.
+//	The file system assumes that the bitmap and root directory files
+//	are kept "open" continuously while Nachos is running.  The contents
+//	of the bitmap and the root directory are also kept in memory, and
+//	only the sectors of them that change are written back (to the 
+//	buffer cache, which writes them to disk later, so that changes
+//	from several operations go to disk together).  Other directories
+//	are read when they are needed; but what names in them refer to is
+//	remembered in a dentry cache (cf. dcache.h), so that a path that
+//	was looked up lately can be found again without reading the
+//	directories along it.
 //
 //	For those operations (such as Create, Remove) that modify the
 //	directory and/or bitmap, if the operation succeeds, the changes
-//	are written immediately back to disk (the two files are kept
-//	open during all this time).  If the operation fails, and we have
-//	modified part of the directory and/or bitmap, we simply discard
-//	the changed version, without writing it back to disk.
+//	are written immediately back (the two files are kept open during
+//	all this time).  If the operation fails, it undoes whatever it
+//	changed in memory.
+//
+//	Each such operation is a transaction of the journal (cf.
+//	journal.h): what it writes to the headers, the directories and
+//	the bitmap reaches the disk all or not at all, so that if Nachos
+//	exits in the middle of it, replaying the journal when Nachos
+//	starts again puts the disk back in order.
+//
+//	If the disk was formatted log-structured, the data of files is
+//	written as a log (cf. segment.h): each sector written, and each
+//	sector a file grows by, is taken from the head of the log, and
+//	the file's header is changed to point there.  A cleaner thread
+//	moves the data left in old segments, so that there are always
+//	clean segments for the log to go on to.  The headers themselves,
+//	the directories and the bitmap stay where they are; their changes
+//	already go to disk sequentially, through the journal.
 //
 // 	Our implementation at this point has the following restrictions:
 //
 //	   there is no synchronization for concurrent accesses
-//	   files have a fixed size, set when the file is created
-//	   files cannot be bigger than about 3KB in size
-//	   there is no hierarchical directory structure, and only a limited
-//	     number of files can be added to the system
-//	   there is no attempt to make the system robust to failures
-//	    (if Nachos exits in the middle of an operation that modifies
-//	    the file system, it may corrupt the disk)
+//	   only the metadata is journaled: the data of files written
+//	    just before a crash may be lost
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -48,20 +66,29 @@
 #include "disk.h"
 #include "bitmap.h"
 #include "directory.h"
+#include "dcache.h"
 #include "filehdr.h"
+#include "journal.h"
+#include "segment.h"
+#include "vnode.h"
 #include "filesys.h"
+#include "system.h"
 
 // Sectors containing the file headers for the bitmap of free sectors,
-// and the directory of files.  These file headers are placed in well-known 
+// and the root directory of files.  These file headers are placed in well-known 
 // sectors, so that they can be located on boot-up.
 #define FreeMapSector 		0
 #define DirectorySector 	1
 
-// Initial file sizes for the bitmap and directory; until the file system
-// supports extensible files, the directory size sets the maximum number 
-// of files that can be loaded onto the disk.
+// The sector after the journal header says how the disk was formatted:
+// it holds LogMagic if the file system is log-structured.
+#define FormatSector		3
+#define LogMagic		0x4c4f4753	// "LOGS"
+
+// Initial file sizes for the bitmap and directories; a directory grows
+// as files are added to it.
 #define FreeMapFileSize 	(NumSectors / BitsInByte)
-#define NumDirEntries 		10
+#define NumDirEntries 		16
 #define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
 
 //----------------------------------------------------------------------
@@ -71,28 +98,46 @@
 //	an empty directory, and a bitmap of free sectors (with almost but
 //	not all of the sectors marked as free).  
 //
-//	If format = FALSE, we just have to open the files
-//	representing the bitmap and the directory.
+//	If format = FALSE, we just have to replay the journal, open
+//	the files representing the bitmap and the directory, and find out
+//	whether the disk was formatted log-structured.
 //
 //	"format" -- should we initialize the disk?
+//	"logStructured" -- if so, should file data be written as a log?
 //----------------------------------------------------------------------
 
-FileSystem::FileSystem(bool format)
+FileSystem::FileSystem(bool format, bool logStructured)
 { 
+    char buffer[SectorSize];
+
     DEBUG('f', "Initializing the file system.\n");
+    dentries = new DentryCache;
     if (format) {
-        BitMap *freeMap = new BitMap(NumSectors);
-        Directory *directory = new Directory(NumDirEntries);
 	FileHeader *mapHdr = new FileHeader;
 	FileHeader *dirHdr = new FileHeader;
 
         DEBUG('f', "Formatting the file system.\n");
+        freeMap = new BitMap(NumSectors);
+        directory = new Directory(NumDirEntries);
 
     // First, allocate space for FileHeaders for the directory and bitmap
     // (make sure no one else grabs these!)
 	freeMap->Mark(FreeMapSector);	    
 	freeMap->Mark(DirectorySector);
 
+    // The journal has a well-known sector too, and a region for its log.
+	freeMap->Mark(JournalSector);
+	for (int i = JournalStart; i < JournalEnd; i++)
+	    freeMap->Mark(i);
+	journal->Format();
+
+    // And so has the note of how the disk is formatted.
+	freeMap->Mark(FormatSector);
+	bzero(buffer, SectorSize);
+	if (logStructured)
+	    *(int *) buffer = LogMagic;
+	bufferCache->WriteSector(FormatSector, buffer);
+
     // Second, allocate space for the data blocks containing the contents
     // of the directory and bitmap files.  There better be enough space!
 
@@ -112,8 +157,8 @@ FileSystem::FileSystem(bool format)
     // The file system operations assume these two files are left open
     // while Nachos is running.
 
-        freeMapFile = new OpenFile(FreeMapSector);
-        directoryFile = new OpenFile(DirectorySector);
+        freeMapFile = new OpenFile(FreeMapSector, TRUE);
+        directoryFile = new OpenFile(DirectorySector, TRUE);
      
     // Once we have the files "open", we can write the initial version
     // of each file back to disk.  The directory at this point is completely
@@ -128,89 +173,176 @@ FileSystem::FileSystem(bool format)
 	if (DebugIsEnabled('f')) {
 	    freeMap->Print();
 	    directory->Print();
-
-        delete freeMap; 
-	delete directory; 
+	}
 	delete mapHdr; 
 	delete dirHdr;
-	}
     } else {
-    // if we are not formatting the disk, just open the files representing
+    // if we are not formatting the disk, finish what was in the journal
+    // when Nachos last stopped, then just open the files representing
     // the bitmap and directory; these are left open while Nachos is running
-        freeMapFile = new OpenFile(FreeMapSector);
-        directoryFile = new OpenFile(DirectorySector);
+	journal->Recover();
+        freeMapFile = new OpenFile(FreeMapSector, TRUE);
+        directoryFile = new OpenFile(DirectorySector, TRUE);
+        freeMap = new BitMap(NumSectors);
+	freeMap->FetchFrom(freeMapFile);
+        directory = new Directory(NumDirEntries);
+	directory->FetchFrom(directoryFile);
+	bufferCache->ReadSector(FormatSector, buffer);
+	logStructured = (*(int *) buffer == LogMagic);
     }
+    segments = logStructured ? new SegmentLog(freeMap) : NULL;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::~FileSystem
+// 	Shut down the file system: write back the headers of files still
+//	open, close the directory and bitmap files, and write back 
+//	everything still dirty in the buffer cache, leaving the journal
+//	empty.
+//----------------------------------------------------------------------
+
+FileSystem::~FileSystem()
+{
+    vnodeTable->Sync();
+    delete directoryFile;		// may give back sectors, so before
+    delete freeMapFile;			// we are done with the bitmap
+    delete segments;
+    delete freeMap;
+    delete directory;
+    delete dentries;
+    journal->Checkpoint();
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Create
 // 	Create a file in the Nachos file system (similar to UNIX create).
-//	Since we can't increase the size of files dynamically, we have
-//	to give Create the initial size of the file.
+//	Files grow as they are written past the end, so the initial size
+//	need not be the final one; giving it just allocates the space
+//	up front.
+//
+//	"name" -- path name of file to be created
+//	"initialSize" -- size of file to be created
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Create(char *name, int initialSize)
+{
+    DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
+    return CreateFile(name, initialSize, FALSE);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::MakeDirectory
+// 	Create an empty directory (similar to UNIX mkdir).
+//
+//	"name" -- path name of the directory to be created
+//----------------------------------------------------------------------
+
+bool
+FileSystem::MakeDirectory(char *name)
+{
+    DEBUG('f', "Creating directory %s\n", name);
+    return CreateFile(name, DirectoryFileSize, TRUE);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CreateFile
+// 	Create a file or a directory.
 //
 //	The steps to create a file are:
-//	  Make sure the file doesn't already exist
+//	  Find the directory it goes in, and make sure the file doesn't 
+//	    already exist
 //        Allocate a sector for the file header
 // 	  Allocate space on disk for the data blocks for the file
-//	  Add the name to the directory
 //	  Store the new file header on disk 
-//	  Flush the changes to the bitmap and the directory back to disk
+//	  Flush the changes to the bitmap back to disk
+//	  If it is a directory, store an empty directory in it
+//	  Add the name to the directory, and flush it back to disk
+//
+//	The bitmap goes first, since the directory file may have to grow
+//	to hold the new name, and growing it takes sectors from the
+//	bitmap.  All of this is one transaction of the journal.
+//
+//	If the disk is log-structured, a file's data sectors are taken
+//	at the head of the log.
 //
 //	Return TRUE if everything goes ok, otherwise, return FALSE.
 //
 // 	Create fails if:
+//		the directory it goes in doesn't exist
 //   		file is already in directory
 //	 	no free space for file header
-//	 	no free entry for file in directory
 //	 	no free space for data blocks for the file 
+//		no free space for the directory to grow
 //
 // 	Note that this implementation assumes there is no concurrent access
 //	to the file system!
 //
-//	"name" -- name of file to be created
+//	"path" -- path name of file to be created
 //	"initialSize" -- size of file to be created
+//	"isDirectory" -- is it a directory?
 //----------------------------------------------------------------------
 
 bool
-FileSystem::Create(char *name, int initialSize)
+FileSystem::CreateFile(char *path, int initialSize, bool isDirectory)
 {
-    Directory *directory;
-    BitMap *freeMap;
+    char name[FileNameMaxLen + 1];
+    Directory *dir, *newDir;
+    OpenFile *dirFile, *newFile;
     FileHeader *hdr;
-    int sector;
+    int parent, sector, hint;
     bool success;
 
-    DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
+    parent = FindParent(path, name);
+    if (parent == -1)
+	return FALSE;			// no directory to put it in
+    journal->Begin();
+    dir = FetchDirectory(parent, &dirFile);
 
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-
-    if (directory->Find(name) != -1)
+    if (dir->Find(name) != -1)
       success = FALSE;			// file is already in directory
     else {	
-        freeMap = new BitMap(NumSectors);
-        freeMap->FetchFrom(freeMapFile);
         sector = freeMap->Find();	// find a sector to hold the file header
     	if (sector == -1) 		
             success = FALSE;		// no free block for file header 
-        else if (!directory->Add(name, sector))
-            success = FALSE;	// no space in directory
 	else {
     	    hdr = new FileHeader;
-	    if (!hdr->Allocate(freeMap, initialSize))
+	    hint = ((segments != NULL) && !isDirectory) ? segments->Head() : -1;
+	    if (!hdr->Allocate(freeMap, initialSize, hint)) {
             	success = FALSE;	// no space on disk for data
-	    else {	
-	    	success = TRUE;
-		// everthing worked, flush all changes back to disk
+		freeMap->Clear(sector);
+	    } else {	
+		if (hint != -1) {
+		    segments->SetOwner(sector, sector);
+		    segments->Allocated(hdr, sector, 0);
+		}
+		// flush the new file back to disk, then name it
     	    	hdr->WriteBack(sector); 		
-    	    	directory->WriteBack(directoryFile);
     	    	freeMap->WriteBack(freeMapFile);
+		if (isDirectory) {	// fits in the space allocated
+		    newFile = new OpenFile(sector, TRUE);
+		    newDir = new Directory(NumDirEntries);
+		    (void) newDir->WriteBack(newFile);
+		    delete newDir;
+		    delete newFile;
+		}
+		ASSERT(dir->Add(name, sector, isDirectory));
+    	    	success = dir->WriteBack(dirFile);
+		if (success)
+		    dentries->Enter(parent, name, sector, isDirectory);
+		else {			// no space to grow the directory
+		    dir->FetchFrom(dirFile);
+		    hdr->Deallocate(freeMap);
+		    freeMap->Clear(sector);
+		    journal->Revoke(sector);
+		    freeMap->WriteBack(freeMapFile);
+		}
 	    }
             delete hdr;
 	}
-        delete freeMap;
     }
-    delete directory;
+    ReleaseDirectory(dir, dirFile);
+    journal->End();
     return success;
 }
 
@@ -218,88 +350,484 @@ FileSystem::Create(char *name, int initialSize)
 // FileSystem::Open
 // 	Open a file for reading and writing.  
 //	To open a file:
-//	  Find the location of the file's header, using the directory 
+//	  Find the location of the file's header, using the directories
+//	    on its path
 //	  Bring the header into memory
 //
-//	"name" -- the text name of the file to be opened
+//	Directories can't be opened this way.
+//
+//	"name" -- the path name of the file to be opened
 //----------------------------------------------------------------------
 
 OpenFile *
 FileSystem::Open(char *name)
 { 
-    Directory *directory = new Directory(NumDirEntries);
+    char last[FileNameMaxLen + 1];
     OpenFile *openFile = NULL;
-    int sector;
+    int parent, sector = -1;
+    bool isDirectory;
 
     DEBUG('f', "Opening file %s\n", name);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name); 
-    if (sector >= 0) 		
+    parent = FindParent(name, last);
+    if (parent != -1)
+	sector = LookupName(parent, last, &isDirectory);
+    if ((sector >= 0) && !isDirectory)
 	openFile = new OpenFile(sector);	// name was found in directory 
-    delete directory;
     return openFile;				// return NULL if not found
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Remove
 // 	Delete a file from the file system.  This requires:
-//	    Remove it from the directory
+//	    Remove it from its directory
 //	    Delete the space for its header
 //	    Delete the space for its data blocks
 //	    Write changes to directory, bitmap back to disk
 //
+//	As in UNIX, if the file is open, the last two steps wait until it
+//	is closed (see VnodeTable::Put and FreeFile).
+//
+//	A directory can only be removed if it is empty.
+//
+//	Removing the name and freeing the file are one transaction of the
+//	journal, unless the file is still open.
+//
 //	Return TRUE if the file was deleted, FALSE if the file wasn't
-//	in the file system.
+//	in the file system (or was a directory with files in it).
 //
-//	"name" -- the text name of the file to be removed
+//	"path" -- the path name of the file to be removed
 //----------------------------------------------------------------------
 
 bool
-FileSystem::Remove(char *name)
+FileSystem::Remove(char *path)
 { 
-    Directory *directory;
-    BitMap *freeMap;
-    FileHeader *fileHdr;
-    int sector;
+    char name[FileNameMaxLen + 1];
+    Directory *dir, *subDir;
+    OpenFile *dirFile, *subFile;
+    Vnode *vnode;
+    int parent, sector;
+    bool isDirectory, empty;
     
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name);
+    parent = FindParent(path, name);
+    if (parent == -1)
+	return FALSE;			 // no such directory
+    dir = FetchDirectory(parent, &dirFile);
+    sector = dir->Find(name, &isDirectory);
     if (sector == -1) {
-       delete directory;
+       ReleaseDirectory(dir, dirFile);
        return FALSE;			 // file not found 
     }
-    fileHdr = new FileHeader;
-    fileHdr->FetchFrom(sector);
+    if (isDirectory) {
+	subDir = FetchDirectory(sector, &subFile);
+	empty = subDir->IsEmpty();
+	ReleaseDirectory(subDir, subFile);
+	if (!empty) {
+	    ReleaseDirectory(dir, dirFile);
+	    return FALSE;		 // directory not empty
+	}
+    }
+    journal->Begin();
+    dir->Remove(name);
+    (void) dir->WriteBack(dirFile);		// flush to disk
+    dentries->Enter(parent, name, -1, FALSE);
+    if (isDirectory)
+	dentries->Purge(sector);
+    ReleaseDirectory(dir, dirFile);
+
+    vnode = vnodeTable->Get(sector);		// the header, as the file's
+    vnode->removed = TRUE;			// openers (if any) see it
+    vnodeTable->Put(vnode);			// free it, unless still open
+    journal->End();
+    return TRUE;
+} 
+
+//----------------------------------------------------------------------
+// FileSystem::FindParent
+// 	Walk down a path name, to the directory holding the last name on
+//	the path.  Return the sector of that directory's header, and copy
+//	the last name into "name"; or return -1 if one of the directories
+//	on the path doesn't exist, or if a name is too long.
+//
+//	Names are separated by "/"; paths start at the root directory,
+//	whether or not they begin with "/".
+//
+//	"path" -- the path name
+//	"name" -- where to put the last name on the path
+//----------------------------------------------------------------------
+
+int
+FileSystem::FindParent(char *path, char *name)
+{
+    int dirSector = DirectorySector, length;
+    bool isDirectory;
+
+    for (;;) {
+	while (*path == '/')
+	    path++;
+	for (length = 0; (path[length] != '\0') && (path[length] != '/'); 
+								length++)
+	    ;
+	if ((length == 0) || (length > FileNameMaxLen))
+	    return -1;			// no name at the end, or too long
+	strncpy(name, path, length);
+	name[length] = '\0';
+	path += length;
+	while (*path == '/')
+	    path++;
+	if (*path == '\0')
+	    return dirSector;		// that was the last name
+	dirSector = LookupName(dirSector, name, &isDirectory);
+	if ((dirSector == -1) || !isDirectory)
+	    return -1;
+    }
+}
 
-    freeMap = new BitMap(NumSectors);
-    freeMap->FetchFrom(freeMapFile);
+//----------------------------------------------------------------------
+// FileSystem::LookupName
+// 	Return the sector of the header of the file a name refers to, in
+//	a given directory, or -1 if there is no such file.  What the
+//	directory says is remembered in the dentry cache -- including
+//	that the name isn't there -- so the directory need only be read
+//	the first time.
+//
+//	"dirSector" -- the sector of the directory's header
+//	"name" -- the name to look up
+//	"isDirectory" -- set to whether the file is a directory
+//----------------------------------------------------------------------
 
-    fileHdr->Deallocate(freeMap);  		// remove data blocks
-    freeMap->Clear(sector);			// remove header block
-    directory->Remove(name);
+int
+FileSystem::LookupName(int dirSector, char *name, bool *isDirectory)
+{
+    Dentry *d = dentries->Lookup(dirSector, name);
+    Directory *dir;
+    OpenFile *dirFile;
+    int sector;
 
-    freeMap->WriteBack(freeMapFile);		// flush to disk
-    directory->WriteBack(directoryFile);        // flush to disk
-    delete fileHdr;
-    delete directory;
-    delete freeMap;
-    return TRUE;
-} 
+    if (d != NULL) {
+	*isDirectory = d->isDirectory;
+	return d->sector;
+    }
+    dir = FetchDirectory(dirSector, &dirFile);
+    sector = dir->Find(name, isDirectory);
+    if (sector == -1)
+	*isDirectory = FALSE;
+    ReleaseDirectory(dir, dirFile);
+    dentries->Enter(dirSector, name, sector, *isDirectory);
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FetchDirectory/ReleaseDirectory
+// 	Get the contents of a directory, and the open file they are in;
+//	and give them back when done.  The root directory is always kept 
+//	in memory; others are read in each time.
+//
+//	"dirSector" -- the sector of the directory's header
+//----------------------------------------------------------------------
+
+Directory *
+FileSystem::FetchDirectory(int dirSector, OpenFile **file)
+{
+    Directory *dir;
+
+    if (dirSector == DirectorySector) {
+	*file = directoryFile;
+	return directory;
+    }
+    *file = new OpenFile(dirSector, TRUE);
+    dir = new Directory(NumDirEntries);
+    dir->FetchFrom(*file);
+    return dir;
+}
+
+void
+FileSystem::ReleaseDirectory(Directory *dir, OpenFile *file)
+{
+    if (dir != directory) {
+	delete dir;
+	delete file;
+    }
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ExtendFile
+// 	Allocate more sectors at the end of an open file, so that it can
+//	grow.  Return FALSE if there isn't enough space.  The header is
+//	written back when the file is closed (see CloseFile).
+//
+//	"hdr" -- the open file's header
+//	"sector" -- where the header is on disk
+//	"count" -- how many sectors to add
+//	"toLog" -- if the disk is log-structured, should the sectors be
+//		taken at the head of the log? (not for metadata)
+//----------------------------------------------------------------------
+
+bool
+FileSystem::ExtendFile(FileHeader *hdr, int sector, int count, bool toLog)
+{
+    int oldSectors = hdr->NumDataSectors();
+    bool success;
+
+    DEBUG('f', "Extending file at %d by %d sectors\n", sector, count);
+    toLog = toLog && (segments != NULL);
+    journal->Begin();
+    success = hdr->Extend(freeMap, count, toLog ? segments->Head() : -1);
+    if (success) {
+	if (toLog)
+	    segments->Allocated(hdr, sector, oldSectors);
+	freeMap->WriteBack(freeMapFile);
+    }
+    journal->End();
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CloseFile
+// 	Write back the header of an open file that has changed, when its
+//	last opener closes it, giving back any sectors that were allocated
+//	past the end of its data.
+//
+//	"hdr" -- the open file's header
+//	"sector" -- where the header is on disk
+//----------------------------------------------------------------------
+
+void
+FileSystem::CloseFile(FileHeader *hdr, int sector)
+{
+    journal->Begin();
+    if (divRoundUp(hdr->FileLength(), SectorSize) * SectorSize 
+		< hdr->SpaceLength())
+	hdr->Trim(freeMap);
+    WriteHeader(hdr, sector);
+    journal->End();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::WriteHeader
+// 	Write back the header of an open file, and the bitmap, in one
+//	transaction.  The sectors the file's data was moved from (see
+//	RelocateSector) are no longer needed once the header is written,
+//	so they are freed.  The data must get to the disk before the
+//	header, so if the disk is log-structured, what has been written to
+//	the segment being filled is written back first.
+//
+//	"hdr" -- the open file's header
+//	"sector" -- where the header is on disk
+//----------------------------------------------------------------------
+
+void
+FileSystem::WriteHeader(FileHeader *hdr, int sector)
+{
+    journal->Begin();
+    if (segments != NULL)
+	segments->Sync();
+    hdr->FreeReplaced(freeMap);
+    freeMap->WriteBack(freeMapFile);
+    hdr->WriteBack(sector);
+    journal->End();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FreeFile
+// 	Give back the data sectors and the header sector of a file that
+//	has been removed, once its last opener closes it.
+//
+//	"hdr" -- the file's header
+//	"sector" -- where the header is on disk
+//----------------------------------------------------------------------
+
+void
+FileSystem::FreeFile(FileHeader *hdr, int sector)
+{
+    DEBUG('f', "Freeing file at %d\n", sector);
+    journal->Begin();
+    hdr->FreeReplaced(freeMap);		// remove data blocks
+    hdr->Deallocate(freeMap);
+    freeMap->Clear(sector);		// remove header block
+    journal->Revoke(sector);
+    if (segments != NULL)
+	segments->SetOwner(sector, -1);
+    freeMap->WriteBack(freeMapFile);
+    journal->End();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::RelocateSector
+// 	Return the disk sector that a sector of an open file should be
+//	written to.  If the disk is log-structured, and the sector isn't
+//	in the segment being filled, it is first moved to the head of the
+//	log: the header is changed to point to a new sector there, and
+//	unless the caller is about to overwrite all of it, the old
+//	contents are copied over.  The old sector is freed when the
+//	header is written back (see WriteHeader) -- now, if too many are
+//	waiting.  If the disk is full, the sector isn't moved.
+//
+//	Allocating the sector, or reading the old one, may put us to
+//	sleep, and someone else may move the sector meanwhile; so the
+//	header is checked again, with interrupts off, before changing it.
+//
+//	"hdr" -- the open file's header
+//	"hdrSector" -- where the header is on disk
+//	"fileSector" -- which sector of the file is to be written
+//	"overwrite" -- will the caller set all of it?
+//----------------------------------------------------------------------
+
+int
+FileSystem::RelocateSector(FileHeader *hdr, int hdrSector, int fileSector,
+				bool overwrite)
+{
+    int oldSector = hdr->ByteToSector(fileSector * SectorSize);
+    int newSector;
+    char *from, *to;
+    IntStatus oldLevel;
+    bool moved;
+
+    if ((segments == NULL) || segments->IsCurrent(oldSector))
+	return oldSector;
+    if (hdr->NumReplaced() == MaxReplaced)
+	WriteHeader(hdr, hdrSector);
+    newSector = segments->Allocate(hdrSector);
+    if (newSector == -1)
+	return oldSector;			// the disk is full
+
+    to = bufferCache->Pin(newSector, TRUE);
+    from = overwrite ? NULL : bufferCache->Pin(oldSector, FALSE);
+    oldLevel = interrupt->SetLevel(IntOff);
+    moved = (hdr->ByteToSector(fileSector * SectorSize) == oldSector)
+		&& hdr->Replace(freeMap, fileSector, newSector);
+    if (!moved) {				// give the new sector back
+	freeMap->Clear(newSector);
+	segments->SetOwner(newSector, -1);
+	bzero(to, SectorSize);
+    } else if (from != NULL)
+	bcopy(from, to, SectorSize);
+    (void) interrupt->SetLevel(oldLevel);
+    if (from != NULL)
+	bufferCache->Unpin(from, FALSE);
+    bufferCache->Unpin(to, moved && !overwrite);
+    if (moved)
+	DEBUG('f', "Moved sector %d of file at %d from %d to %d\n",
+		fileSector, hdrSector, oldSector, newSector);
+    return hdr->ByteToSector(fileSector * SectorSize);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CleanSegments
+// 	Clean segments of the log, until there are enough clean ones for
+//	the log to go on to, or no more can be cleaned.  The first time,
+//	find out which files own the sectors written before Nachos
+//	started.  This is run by the cleaner thread.
+//----------------------------------------------------------------------
+
+void
+FileSystem::CleanSegments()
+{
+    bool tried[NumSegments];
+    int seg;
+
+    for (seg = 0; seg < NumSegments; seg++)
+	tried[seg] = FALSE;
+    if (!segments->ownersKnown) {
+	segments->ownersKnown = TRUE;
+	FindOwners(DirectorySector);
+    }
+    while ((segments->NumClean() < CleanHigh)
+		&& ((seg = segments->Victim(tried)) != -1))
+	CleanSegment(seg);
+    segments->cleaning = FALSE;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CleanSegment
+// 	Move each sector in use in a segment to the head of the log; then
+//	write back the headers that now point there, so that the old
+//	sectors are freed.  A sector is left where it is if we don't know
+//	whose it is, or it isn't file data, or the file is open (so that
+//	no one is writing to it while we move it), or its last opener is
+//	still closing or freeing it.
+//
+//	"seg" -- which segment to clean
+//----------------------------------------------------------------------
+
+void
+FileSystem::CleanSegment(int seg)
+{
+    Vnode *held[SegmentSize], *v;
+    int numHeld = 0, owner, fileSector, moved = 0, i, j;
+
+    DEBUG('f', "Cleaning segment %d\n", seg);
+    for (i = seg * SegmentSize; i < (seg + 1) * SegmentSize; i++) {
+	owner = segments->Owner(i);
+	if (!freeMap->Test(i) || (owner == -1) || (owner == i)
+		|| (segments->Owner(owner) != owner))
+	    continue;				// free, or not known data
+	for (j = 0; (j < numHeld) && (held[j]->sector != owner); j++)
+	    ;
+	if (j == numHeld)
+	    held[numHeld++] = vnodeTable->Get(owner);
+	v = held[j];
+	fileSector = v->hdr->SectorToFile(i);
+	if ((v->refCount == 1) && !v->closing && !v->removed
+		&& !v->metadata && (fileSector != -1)
+		&& (RelocateSector(v->hdr, owner, fileSector, FALSE) != i))
+	    moved++;
+    }
+    for (j = 0; j < numHeld; j++) {
+	if (!held[j]->closing && !held[j]->removed
+		&& (held[j]->hdr->NumReplaced() > 0))
+	    WriteHeader(held[j]->hdr, held[j]->sector);
+	vnodeTable->Put(held[j]);
+    }
+    stats->numSegmentsCleaned++;
+    stats->numSectorsCleaned += moved;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FindOwners
+// 	Note the owner of each data sector of the files under a directory,
+//	reading their headers.  The entries are looked up again after
+//	each header is read, in case the directory changed meanwhile.
+//
+//	"dirSector" -- the sector of the directory's header
+//----------------------------------------------------------------------
+
+void
+FileSystem::FindOwners(int dirSector)
+{
+    Directory *dir;
+    OpenFile *dirFile;
+    Vnode *v;
+    int sector;
+    bool isDirectory;
+
+    dir = FetchDirectory(dirSector, &dirFile);
+    for (int i = 0; i < dir->TableSize(); i++) {
+	sector = dir->SectorAt(i, &isDirectory);
+	if (sector == -1)
+	    continue;
+	if (isDirectory) {
+	    FindOwners(sector);
+	    continue;
+	}
+	v = vnodeTable->Get(sector);
+	if (!v->removed) {
+	    segments->SetOwner(sector, sector);
+	    segments->Allocated(v->hdr, sector, 0);
+	}
+	vnodeTable->Put(v);
+    }
+    ReleaseDirectory(dir, dirFile);
+}
 
 //----------------------------------------------------------------------
 // FileSystem::List
-// 	List all the files in the file system directory.
+// 	List all the files in the root directory.
 //----------------------------------------------------------------------
 
 void
 FileSystem::List()
 {
-    Directory *directory = new Directory(NumDirEntries);
-
-    directory->FetchFrom(directoryFile);
     directory->List();
-    delete directory;
 }
 
 //----------------------------------------------------------------------
@@ -317,8 +845,6 @@ FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    BitMap *freeMap = new BitMap(NumSectors);
-    Directory *directory = new Directory(NumDirEntries);
 
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
@@ -328,14 +854,10 @@ FileSystem::Print()
     dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
 
-    freeMap->FetchFrom(freeMapFile);
     freeMap->Print();
 
-    directory->FetchFrom(directoryFile);
     directory->Print();
 
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
-    delete directory;
 } 
@@ -20,14 +20,18 @@
 //	file system (in a file named "DISK"). 
 //
 //	In the "real" implementation, there are two key data structures used 
-//	in the file system.  There is a single "root" directory, listing
-//	all of the files in the file system; unlike UNIX, the baseline
-//	system does not provide a hierarchical directory structure.  
+//	in the file system.  There is a "root" directory, at the top of
+//	a tree of directories, as in UNIX; files are named by paths such
+//	as "a/b/c" (or "/a/b/c"), starting from the root.
 //	In addition, there is a bitmap for allocating
 //	disk sectors.  Both the root directory and the bitmap are themselves
 //	stored as files in the Nachos file system -- this causes an interesting
 //	bootstrap problem when the simulated disk is initialized. 
 //
+//	The disk can also be formatted "log-structured" (see segment.h):
+//	then the data of files is written to the disk as a log, in long
+//	sequential runs, rather than in place.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -43,7 +47,7 @@
 				// implementation is available
 class FileSystem {
   public:
-    FileSystem(bool format) {}
+    FileSystem(bool format, bool logStructured = FALSE) {}
 
     bool Create(char *name, int initialSize) { 
 	int fileDescriptor = OpenForWrite(name);
@@ -65,31 +69,91 @@ class FileSystem {
 };
 
 #else // FILESYS
+class FileHeader;
+class BitMap;
+class Directory;
+class DentryCache;
+class SegmentLog;
+
 class FileSystem {
   public:
-    FileSystem(bool format);		// Initialize the file system.
+    FileSystem(bool format, bool logStructured = FALSE);
+					// Initialize the file system.
 					// Must be called *after* "synchDisk" 
 					// has been initialized.
     					// If "format", there is nothing on
 					// the disk, so initialize the directory
-    					// and the bitmap of free blocks.
+    					// and the bitmap of free blocks, and
+					// note whether it is "logStructured"
+    ~FileSystem();			// Write back anything cached
 
     bool Create(char *name, int initialSize);  	
 					// Create a file (UNIX creat)
 
-    OpenFile* Open(char *name); 	// Open a file (UNIX open)
+    bool MakeDirectory(char *name);	// Create a directory (UNIX mkdir)
 
-    bool Remove(char *name);  		// Delete a file (UNIX unlink)
+    OpenFile* Open(char *name); 	// Open a file (UNIX open)
 
-    void List();			// List all the files in the file system
+    bool Remove(char *name);  		// Delete a file, or an empty
+					// directory (UNIX unlink, rmdir)
+
+    bool ExtendFile(FileHeader *hdr, int sector, int count, 
+					bool toLog = FALSE);
+					// Allocate "count" more sectors for
+					// an open file, at the head of the
+					// log if "toLog" and there is one
+    void CloseFile(FileHeader *hdr, int sector);
+					// Write back an open file's header,
+					// freeing its unused sectors
+    void WriteHeader(FileHeader *hdr, int sector);
+					// Write back an open file's header,
+					// freeing the sectors its data
+					// was moved from
+    void FreeFile(FileHeader *hdr, int sector);
+					// Free a removed file's sectors
+    int RelocateSector(FileHeader *hdr, int hdrSector, int fileSector,
+					bool overwrite);
+					// Where to write a sector of a file:
+					// if log-structured, move it to the
+					// head of the log first
+    void CleanSegments();		// Move sectors out of the segments
+					// of the log that are mostly free
+
+    void List();			// List all the files in the root
+					// directory
 
     void Print();			// List all the files and their contents
 
   private:
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
+   BitMap* freeMap;			// The contents of freeMapFile, kept
+					// in memory while we run
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
+   Directory* directory;		// The contents of directoryFile,
+					// kept in memory while we run
+   DentryCache* dentries;		// What names in directories refer
+					// to, as found lately
+   SegmentLog* segments;		// The log of segments, or NULL if
+					// the disk isn't log-structured
+
+   bool CreateFile(char *name, int initialSize, bool isDirectory);
+					// Create a file or a directory
+   int FindParent(char *path, char *name);
+					// Find the directory holding the 
+					// file "path" names, and the file's
+					// name in it
+   int LookupName(int dirSector, char *name, bool *isDirectory);
+					// Find a name in a directory
+   Directory* FetchDirectory(int dirSector, OpenFile **file);
+   					// Open a directory, and read it in
+   void ReleaseDirectory(Directory *dir, OpenFile *file);
+					// Done with a directory
+   void CleanSegment(int seg);		// Move the sectors in use out of
+					// a segment
+   void FindOwners(int dirSector);	// Note the owners of the sectors
+					// of the files under a directory
 };
 
 #endif // FILESYS
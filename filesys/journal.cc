@@ -0,0 +1,396 @@
+// journal.cc
+//	Routines to manage the write-ahead journal of the file system's
+//	metadata.  See journal.h for an overview.
+//
+//	The log is written directly to the disk, not through the buffer
+//	cache: no one reads it but Recover, when nothing is cached yet.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "journal.h"
+#include "system.h"
+#include <strings.h>
+
+//----------------------------------------------------------------------
+// Checksum
+// 	Compute a checksum of a transaction as it is written to the log,
+//	so that one only partly written before a crash isn't replayed.
+//	The descriptor's "checksum" field must be zero.
+//
+//	"buffer" -- the descriptor, followed by the sectors
+//	"numSectors" -- how many sectors in all
+//----------------------------------------------------------------------
+
+static unsigned int
+Checksum(char *buffer, int numSectors)
+{
+    unsigned int *words = (unsigned int *) buffer;
+    unsigned int sum = 0;
+    int numWords = numSectors * SectorSize / sizeof(unsigned int);
+
+    for (int i = 0; i < numWords; i++)
+	sum = ((sum << 1) | (sum >> 31)) + words[i];
+    return sum;
+}
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Initialize the journal, with no transaction open.  Nothing is
+//	read from disk until Recover.
+//----------------------------------------------------------------------
+
+Journal::Journal()
+{
+    depth = count = numRevoked = 0;
+    owner = NULL;
+    waiters = 0;
+    idle = new Semaphore("journal idle", 0);
+    sequence = 1;
+    tail = JournalStart;
+    for (int i = 0; i < NumSectors; i++)
+	logged[i] = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Journal::~Journal
+// 	De-allocate the journal.
+//----------------------------------------------------------------------
+
+Journal::~Journal()
+{
+    ASSERT(depth == 0);
+    delete idle;
+}
+
+//----------------------------------------------------------------------
+// Journal::Format
+// 	Write an empty journal on a disk being formatted.  The caller
+//	must mark the journal's sectors in use in the bitmap.
+//
+//	The log is cleared, too: sequence numbers start again from 1, so
+//	a transaction left in it by an earlier file system on the disk
+//	could otherwise be taken for one of ours, and replayed.
+//----------------------------------------------------------------------
+
+void
+Journal::Format()
+{
+    char *buffer = new char[(JournalEnd - JournalStart) * SectorSize];
+
+    bzero(buffer, (JournalEnd - JournalStart) * SectorSize);
+    synchDisk->WriteSectors(JournalStart, JournalEnd - JournalStart, buffer);
+    delete [] buffer;
+
+    sequence = 1;
+    tail = JournalStart;
+    WriteHeader();
+}
+
+//----------------------------------------------------------------------
+// Journal::Recover
+// 	Replay the transactions in the log, starting where the journal
+//	header says, and stopping at the first one that isn't there (the
+//	log goes on with what was written before the last checkpoint,
+//	which has older sequence numbers) or wasn't completely written.
+//	Then empty the log.
+//
+//	The log is read twice: first to find which sectors are revoked,
+//	and by which transaction, then to replay the rest.
+//
+//	This must be called before anything is read through the buffer
+//	cache, since the sectors are written straight to disk.
+//----------------------------------------------------------------------
+
+void
+Journal::Recover()
+{
+    char *buffer = new char[(MaxTransaction + 1) * SectorSize];
+    RawJournalHeader *hdr = (RawJournalHeader *) buffer;
+    RawTransaction *t = (RawTransaction *) buffer;
+    int *revokedBy = new int[NumSectors];	// the last transaction to
+						// revoke each sector, or 0
+    int head, position, seq, i, replayed = 0;
+
+    synchDisk->ReadSector(JournalSector, buffer);
+    ASSERT(hdr->magic == JournalMagic);		// else, format the disk
+    sequence = hdr->sequence;
+    head = hdr->head;
+
+    for (i = 0; i < NumSectors; i++)
+	revokedBy[i] = 0;
+    for (position = head, seq = sequence; 
+		ReadTransaction(position, seq, buffer);
+		position += t->count + 1, seq++)
+	for (i = 0; i < t->numRevoked; i++)
+	    revokedBy[t->sectors[t->count + i]] = seq;
+
+    for (position = head; ReadTransaction(position, sequence, buffer);
+		position += t->count + 1, sequence++) {
+	for (i = 0; i < t->count; i++)
+	    if (revokedBy[t->sectors[i]] < sequence)
+		synchDisk->WriteSector(t->sectors[i],
+				       &buffer[(i + 1) * SectorSize]);
+	replayed++;
+    }
+    DEBUG('f', "Replayed %d transactions from the journal.\n", replayed);
+    delete [] revokedBy;
+    delete [] buffer;
+
+    tail = JournalStart;
+    WriteHeader();
+}
+
+//----------------------------------------------------------------------
+// Journal::Begin
+// 	Start a transaction.  If another thread has one open, wait until
+//	it is committed.  If it is not nested in another one, and the log
+//	may not have room for it, checkpoint first -- while no sectors are
+//	pinned by the journal, so that all of them go home.
+//----------------------------------------------------------------------
+
+void
+Journal::Begin()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    while ((depth > 0) && (owner != currentThread)) {
+	waiters++;
+	idle->P();
+    }
+    owner = currentThread;
+    (void) interrupt->SetLevel(oldLevel);
+
+    if ((depth++ == 0) && (tail + MaxTransaction + 1 > JournalEnd))
+	Checkpoint();
+}
+
+//----------------------------------------------------------------------
+// Journal::Log
+// 	Add a sector to the current transaction, before the caller changes
+//	it.  The sector is pinned in the buffer cache until the transaction
+//	is committed.  If there is no transaction, the change isn't logged.
+//
+//	If the transaction has no more room, commit what it has so far.
+//
+//	"sector" -- the sector about to be changed
+//	"overwrite" -- will the caller set all of it? (see BufferCache::Pin)
+//----------------------------------------------------------------------
+
+void
+Journal::Log(int sector, bool overwrite)
+{
+    int i;
+
+    if (depth == 0)
+	return;
+    for (i = 0; i < numRevoked; i++)
+	if (revoked[i] == sector) {		// freed, and now reused
+	    revoked[i] = revoked[--numRevoked];
+	    break;
+	}
+    for (i = 0; i < count; i++)
+	if (sectors[i] == sector)
+	    return;				// already pinned
+    MakeRoom();
+    sectors[count] = sector;
+    data[count++] = bufferCache->Pin(sector, overwrite);
+}
+
+//----------------------------------------------------------------------
+// Journal::Revoke
+// 	Note that a sector is being freed, in the current transaction, so
+//	that if it is reused for data, replay won't write the copies of it
+//	in the log over the data.  There is nothing to do for a sector
+//	not logged since the last checkpoint, or if there is no
+//	transaction.
+//
+//	If the transaction has no more room, commit what it has so far.
+//
+//	"sector" -- the sector being freed
+//----------------------------------------------------------------------
+
+void
+Journal::Revoke(int sector)
+{
+    int i;
+
+    if (depth == 0)
+	return;
+    for (i = 0; i < numRevoked; i++)
+	if (revoked[i] == sector)
+	    return;				// already revoked
+    for (i = 0; i < count; i++)
+	if (sectors[i] == sector)
+	    break;
+    if ((i == count) && !logged[sector])
+	return;
+    MakeRoom();
+    if ((count > 0) || logged[sector])		// unless we just checkpointed
+	revoked[numRevoked++] = sector;
+}
+
+//----------------------------------------------------------------------
+// Journal::MakeRoom
+// 	Make sure the current transaction has room for one more sector,
+//	logged or revoked: if not, commit what it has so far, and
+//	checkpoint if the log has no room for another one.
+//----------------------------------------------------------------------
+
+void
+Journal::MakeRoom()
+{
+    if (count + numRevoked < MaxTransaction)
+	return;
+    Commit();
+    if (tail + MaxTransaction + 1 > JournalEnd)
+	Checkpoint();
+}
+
+//----------------------------------------------------------------------
+// Journal::End
+// 	Finish a transaction; if it is the outermost one, commit it, and
+//	let the threads waiting to begin one go ahead.
+//----------------------------------------------------------------------
+
+void
+Journal::End()
+{
+    IntStatus oldLevel;
+
+    ASSERT((depth > 0) && (owner == currentThread));
+    if ((depth == 1) && ((count > 0) || (numRevoked > 0)))
+	Commit();			// still ours while we wait for it
+    if (--depth > 0)
+	return;
+    oldLevel = interrupt->SetLevel(IntOff);
+    owner = NULL;
+    while (waiters > 0) {
+	waiters--;
+	idle->V();
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	Write the current transaction to the log: its descriptor and
+//	copies of its sectors, with one request to the disk.  Once that is
+//	done, unpin the sectors, so that the buffer cache can write them
+//	back home.  The sectors revoked are only listed in the descriptor.
+//----------------------------------------------------------------------
+
+void
+Journal::Commit()
+{
+    char *buffer = new char[(count + 1) * SectorSize];
+    RawTransaction *t = (RawTransaction *) buffer;
+    int i;
+
+    ASSERT(tail + count + 1 <= JournalEnd);
+    DEBUG('f', "Committing transaction %d, %d sectors, %d revoked, at %d\n",
+		sequence, count, numRevoked, tail);
+    bzero(buffer, SectorSize);
+    t->magic = JournalMagic;
+    t->sequence = sequence;
+    t->count = count;
+    t->numRevoked = numRevoked;
+    for (i = 0; i < count; i++) {
+	t->sectors[i] = sectors[i];
+	bcopy(data[i], &buffer[(i + 1) * SectorSize], SectorSize);
+    }
+    for (i = 0; i < numRevoked; i++)
+	t->sectors[count + i] = revoked[i];
+    t->checksum = Checksum(buffer, count + 1);
+    synchDisk->WriteSectors(tail, count + 1, buffer);
+    delete [] buffer;
+
+    stats->numJournalCommits++;
+    stats->numJournalSectors += count + 1;
+    tail += count + 1;
+    sequence++;
+    for (i = 0; i < count; i++) {
+	logged[sectors[i]] = TRUE;
+	bufferCache->Unpin(data[i], TRUE);
+    }
+    for (i = 0; i < numRevoked; i++)
+	logged[revoked[i]] = FALSE;	// no copy of it will be replayed
+    count = numRevoked = 0;
+}
+
+//----------------------------------------------------------------------
+// Journal::Checkpoint
+// 	Write back every dirty sector in the buffer cache, so that the
+//	transactions in the log are no longer needed; then start the log
+//	again from the beginning.  There must be no open transaction with
+//	sectors pinned, or they would not be written back.
+//----------------------------------------------------------------------
+
+void
+Journal::Checkpoint()
+{
+    ASSERT((count == 0) && (numRevoked == 0));
+    DEBUG('f', "Checkpointing the journal.\n");
+    bufferCache->Flush();
+    for (int i = 0; i < NumSectors; i++)
+	logged[i] = FALSE;
+    tail = JournalStart;
+    WriteHeader();
+    stats->numJournalCheckpoints++;
+}
+
+//----------------------------------------------------------------------
+// Journal::ReadTransaction
+// 	Read the transaction at "position" in the log into "buffer", and
+//	return TRUE if it is the one numbered "seq", and was completely
+//	written.  Otherwise, this is the end of the log.
+//
+//	"buffer" -- room for a descriptor and MaxTransaction sectors
+//----------------------------------------------------------------------
+
+bool
+Journal::ReadTransaction(int position, int seq, char *buffer)
+{
+    RawTransaction *t = (RawTransaction *) buffer;
+    unsigned int sum;
+
+    if (position >= JournalEnd)
+	return FALSE;
+    synchDisk->ReadSector(position, buffer);
+    if ((t->magic != JournalMagic) || (t->sequence != seq)
+	    || (t->count < 0) || (t->numRevoked < 0)
+	    || (t->count + t->numRevoked == 0)
+	    || (t->count + t->numRevoked > MaxTransaction)
+	    || (position + t->count + 1 > JournalEnd))
+	return FALSE;
+    for (int i = 0; i < t->count + t->numRevoked; i++)
+	if ((t->sectors[i] < 0) || (t->sectors[i] >= NumSectors))
+	    return FALSE;
+    if (t->count > 0)
+	synchDisk->ReadSectors(position + 1, t->count, &buffer[SectorSize]);
+    sum = t->checksum;
+    t->checksum = 0;
+    return Checksum(buffer, t->count + 1) == sum;	// else, cut short
+							// by the crash
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteHeader
+// 	Write the journal header: replay starts with the next transaction,
+//	at the tail of the log.
+//----------------------------------------------------------------------
+
+void
+Journal::WriteHeader()
+{
+    char buffer[SectorSize];
+    RawJournalHeader *hdr = (RawJournalHeader *) buffer;
+
+    bzero(buffer, SectorSize);
+    hdr->magic = JournalMagic;
+    hdr->sequence = sequence;
+    hdr->head = tail;
+    synchDisk->WriteSector(JournalSector, buffer);
+}
@@ -0,0 +1,136 @@
+// journal.h
+//	Data structures for a write-ahead journal of the file system's
+//	metadata, so that a crash can't leave the disk inconsistent.
+//
+//	Each operation that changes metadata -- file headers, directories,
+//	the bitmap of free sectors -- is a "transaction".  The sectors it
+//	changes are pinned in the buffer cache, so that none of them
+//	reach their home on disk until the whole transaction has been
+//	written to the journal: a descriptor sector, listing where each
+//	sector goes, then copies of the sectors, all in one run of
+//	consecutive sectors.  After that, the buffer cache writes them
+//	back whenever it likes.
+//
+//	The journal is a region of the disk used as a circular log.  When
+//	there is no room left for another transaction, we "checkpoint":
+//	write back everything in the buffer cache, and start the log
+//	again from the beginning.  When Nachos starts, the transactions
+//	still in the log are written to their homes again ("replayed"),
+//	so that the metadata is as it was after the last one that was
+//	written to the log completely.
+//
+//	Only metadata goes through the journal.  The data of a file
+//	written just before a crash may be lost; and the sectors of a
+//	file growing at the time may stay allocated to no file.
+//
+//	Since data isn't logged, a sector that was logged as metadata,
+//	then freed and reused for a file's data, must not be replayed:
+//	that would write the old metadata over the data.  So freeing a
+//	sector logged since the last checkpoint "revokes" it: the
+//	transaction notes the sector in its descriptor, and replay skips
+//	the copies of it logged up to and including that transaction.
+//
+//	Transactions may nest; the sectors changed by nested transactions
+//	all go in the outermost one.  A transaction that changes more than
+//	MaxTransaction sectors is committed in pieces, and so is no longer
+//	atomic.
+//
+//	Only one thread at a time can have a transaction open; another
+//	thread that begins one waits until it is committed.
+//
+//      We assume mutual exclusion is provided by the caller.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "disk.h"
+#include "synch.h"
+
+// Where the journal is on disk.  The header, which says where in the
+// log to start replaying, is in a well-known sector (after those of the
+// bitmap's and the root directory's headers); the log is the two tracks
+// after the first one, close to the rest of the metadata.
+#define JournalSector	2
+#define JournalStart	SectorsPerTrack
+#define JournalEnd	(3 * SectorsPerTrack)
+
+#define JournalMagic	0x4a524e4c	// "JRNL"
+#define MaxTransaction	((int) (SectorSize / sizeof(int)) - 5)
+					// sectors listed in one descriptor
+
+// How the journal header is laid out on disk.
+class RawJournalHeader {
+  public:
+    int magic;				// JournalMagic
+    int sequence;			// # of the first transaction to replay
+    int head;				// where in the log it starts
+};
+
+// How the descriptor of a transaction is laid out on disk.
+class RawTransaction {
+  public:
+    int magic;				// JournalMagic
+    int sequence;			// # of the transaction; each one
+					// logged gets the next number
+    int count;				// # of sectors that follow
+    int numRevoked;			// # of sectors revoked
+    unsigned int checksum;		// of the fields above and the sectors
+    int sectors[MaxTransaction];	// where each of them goes, then
+					// which sectors are revoked
+};
+
+// The following class defines the journal.
+class Journal {
+  public:
+    Journal();				// Initialize; Format or Recover
+					// must be called before use
+    ~Journal();
+
+    void Format();			// Start with an empty journal
+    void Recover();			// Replay the journal on disk
+
+    void Begin();			// Start a transaction
+    void Log(int sector, bool overwrite);
+					// "sector" is about to be changed,
+					// in the current transaction; pin it
+					// (see BufferCache::Pin) until commit
+    void Revoke(int sector);		// "sector" is being freed, in the
+					// current transaction; don't replay
+					// what was logged of it
+    void End();				// Finish a transaction, and commit it
+					// if it is the outermost one
+
+    void Checkpoint();			// Write back everything, and empty
+					// the log
+
+  private:
+    int depth;				// # of transactions begun, not ended
+    Thread *owner;			// the thread that began them
+    int waiters;			// # of other threads waiting to begin
+    Semaphore *idle;			// one, and what they wait on
+    int count;				// # of sectors changed in them
+    int sectors[MaxTransaction];	// which ones
+    char *data[MaxTransaction];		// and their pinned buffers
+    int numRevoked;			// # of sectors revoked in them
+    int revoked[MaxTransaction];	// which ones
+    bool logged[NumSectors];		// which sectors are in the log
+					// since the last checkpoint
+
+    int sequence;			// # of the next transaction
+    int tail;				// where in the log it goes
+
+    void MakeRoom();			// Commit, if the transaction is full
+    void Commit();			// Write the transaction to the log
+    bool ReadTransaction(int position, int seq, char *buffer);
+					// Read a transaction from the log,
+					// if it is all there
+    void WriteHeader();			// Write the journal header
+};
+
+#endif // JOURNAL_H
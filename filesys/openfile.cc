@@ -5,7 +5,16 @@
 //	the OpenFile data structure).
 //
 //	Also as in UNIX, for convenience, we keep the file header in
-//	memory while the file is open.
+//	memory while the file is open -- one copy, in the file's vnode,
+//	however many times the file is open (see vnode.h).
+//
+//	Small writes are gathered up: bytes written to part of a sector 
+//	are kept in the vnode, and only put into the sector (which may 
+//	mean reading it) once the sector is full, or the file is read
+//	there, written elsewhere, or closed for the last time.  So a file
+//	written a few bytes at a time costs about one disk write per
+//	sector, and no reads.  Since every opener of the file reads and
+//	writes through the same vnode, they all see the bytes at once.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -14,6 +23,7 @@
 #include "copyright.h"
 #include "filehdr.h"
 #include "openfile.h"
+#include "vnode.h"
 #include "system.h"
 #ifdef HOST_SPARC
 #include <strings.h>
@@ -22,26 +32,34 @@
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory while the file is open, unless it is there already.
 //
 //	"sector" -- the location on disk of the file header for this file
+//	"metadata" -- is it one of the file system's own files, whose
+//		writes go through the journal?
 //----------------------------------------------------------------------
 
-OpenFile::OpenFile(int sector)
+OpenFile::OpenFile(int sector, bool metadata)
 { 
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    vnode = vnodeTable->Get(sector);
+    if (metadata)
+	vnode->metadata = TRUE;
+    hdr = vnode->hdr;
     seekPosition = 0;
+    nextSequential = 0;
+    readAhead = 0;
+    prefetchedTo = 0;
 }
 
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
 // 	Close a Nachos file, de-allocating any in-memory data structures.
+//	The vnode is finished with once the file's last opener closes it.
 //----------------------------------------------------------------------
 
 OpenFile::~OpenFile()
 {
-    delete hdr;
+    vnodeTable->Put(vnode);
 }
 
 //----------------------------------------------------------------------
@@ -101,23 +119,40 @@ OpenFile::Write(char *into, int numBytes)
 //	   We read in all of the full or partial sectors that are part of the
 //	   request, but we only copy the part we are interested in.
 //	For WriteAt:
-//	   We must first read in any sectors that will be partially written,
-//	   so that we don't overwrite the unmodified portion.  We then copy
-//	   in the data that will be modified, and write back all the full
-//	   or partial sectors that are part of the request.
+//	   Whole sectors are written straight into the buffer cache (at
+//	   the head of the log, if the disk is log-structured).  The
+//	   bytes for a partial sector are kept in the vnode, to be merged
+//	   with the rest of the sector later (see Vnode::WritePartial), so
+//	   that we don't overwrite the unmodified portion.
+//
+//	   A write can start anywhere up to the end of the file; if it 
+//	   runs past the end, the file grows (see Vnode::Grow).  If the disk
+//	   fills up, only what fits is written.
+//
+//	A file small enough to be kept in its header is just copied to
+//	or from there; the header is written back when the file is 
+//	closed.
 //
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
 //	"numBytes" -- the number of bytes to transfer
 //	"position" -- the offset within the file of the first byte to be
 //			read/written
+//
+//	ReadAt also keeps track of whether the file is being read 
+//	sequentially; if so, once it has what was asked for, it starts
+//	reading the next few sectors into the buffer cache, so that the
+//	disk can work on them while the caller uses what it read.  A read
+//	anywhere else means the reader is skipping around; reading ahead
+//	would only waste the disk's time and the cache's space, so we stop
+//	until it goes sequentially again.
 //----------------------------------------------------------------------
 
 int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
+    int i, run, sector, firstSector, lastSector, numSectors;
     char *buf;
 
     if ((numBytes <= 0) || (position >= fileLength))
@@ -127,61 +162,117 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
     DEBUG('f', "Reading %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
 
+    if (position == nextSequential) {
+	readAhead *= 2;
+	if (readAhead < MinReadAhead)
+	    readAhead = MinReadAhead;
+	else if (readAhead > MaxReadAhead)
+	    readAhead = MaxReadAhead;
+    } else {
+	readAhead = 0;
+	prefetchedTo = 0;
+    }
+    nextSequential = position + numBytes;
+
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
     numSectors = 1 + lastSector - firstSector;
+    if (hdr->IsInline()) {		// the data is in the header
+	bcopy(&hdr->InlineData()[position], into, numBytes);
+	return numBytes;
+    }
+    if ((vnode->pendingSector >= firstSector) 
+		&& (vnode->pendingSector <= lastSector))
+	vnode->FlushPending();		// so that we read what was written
 
-    // read in all the full and partial sectors that we need
+    // read in all the full and partial sectors that we need, a run of
+    // consecutive disk sectors at a time
     buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
+    for (i = firstSector; i <= lastSector; i += run) {
+	sector = hdr->ByteToRun(i * SectorSize, &run);
+	if (run > lastSector - i + 1)
+	    run = lastSector - i + 1;
+        bufferCache->ReadSectors(sector, run, 
 					&buf[(i - firstSector) * SectorSize]);
+    }
 
     // copy the part we want
     bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
     delete [] buf;
+
+    if (readAhead > 0)
+	ReadAheadFrom(lastSector + 1);
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::ReadAheadFrom
+// 	Start reading up to "readAhead" sectors of the file into the
+//	buffer cache, without waiting for them.  Sectors we have already
+//	started on are skipped.
+//
+//	"fileSector" -- the first sector after the ones just read, 
+//		counting from the start of the file
+//----------------------------------------------------------------------
+
+void
+OpenFile::ReadAheadFrom(int fileSector)
+{
+    int numFileSectors = divRoundUp(hdr->FileLength(), SectorSize);
+    int last = fileSector + readAhead;
+    int i;
+
+    if (last > numFileSectors)
+	last = numFileSectors;
+    i = (prefetchedTo > fileSector) ? prefetchedTo : fileSector;
+    for (; i < last; i++)
+	bufferCache->Prefetch(hdr->ByteToSector(i * SectorSize));
+    if (last > prefetchedTo)
+	prefetchedTo = last;
+}
+
 int
 OpenFile::WriteAt(char *from, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
+    int done, count, sector;
+    char *data;
 
-    if ((numBytes <= 0) || (position >= fileLength))
+    if ((numBytes <= 0) || (position > fileLength))
 	return 0;				// check request
-    if ((position + numBytes) > fileLength)
-	numBytes = fileLength - position;
     DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
+    if (((position + numBytes) > fileLength) 
+		&& !vnode->Grow(position + numBytes))
+	numBytes = hdr->FileLength() - position;	// the disk is full
+    if (numBytes <= 0)
+	return 0;
+    if (hdr->IsInline()) {		// still small enough for the header
+	bcopy(from, &hdr->InlineData()[position], numBytes);
+	vnode->dirty = TRUE;
+	return numBytes;
+    }
 
-    firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
-
-    buf = new char[numSectors * SectorSize];
-
-    firstAligned = (position == (firstSector * SectorSize));
-    lastAligned = ((position + numBytes) == ((lastSector + 1) * SectorSize));
-
-// read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
-				SectorSize, lastSector * SectorSize);	
-
-// copy in the bytes we want to change 
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
-
-// write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-    delete [] buf;
+    for (done = 0; done < numBytes; done += count) {
+	count = SectorSize - ((position + done) % SectorSize);
+	if (count > numBytes - done)
+	    count = numBytes - done;
+	if (count < SectorSize) {
+	    vnode->WritePartial(&from[done], count, position + done);
+	    continue;
+	}
+	if (divRoundDown(position + done, SectorSize) == vnode->pendingSector)
+	    vnode->pendingSector = -1;		// all overwritten anyway
+	if (vnode->metadata) {
+	    sector = hdr->ByteToSector(position + done);
+	    journal->Log(sector, TRUE);
+	} else
+	    sector = vnode->Relocate(divRoundDown(position + done, SectorSize),
+					TRUE);
+	data = bufferCache->Pin(sector, TRUE);
+	bcopy(&from[done], data, SectorSize);
+	bufferCache->Unpin(data, TRUE);
+    }
     return numBytes;
 }
 
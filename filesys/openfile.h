@@ -60,11 +60,20 @@ class OpenFile {
 
 #else // FILESYS
 class FileHeader;
+class Vnode;
+
+// When a file is read sequentially, we read ahead of the reader,
+// starting with MinReadAhead sectors and doubling up to MaxReadAhead
+// as long as the reads stay sequential.
+#define MinReadAhead	2
+#define MaxReadAhead	16
 
 class OpenFile {
   public:
-    OpenFile(int sector);		// Open a file whose header is located
-					// at "sector" on the disk
+    OpenFile(int sector, bool metadata = FALSE);
+					// Open a file whose header is located
+					// at "sector" on the disk; "metadata"
+					// if it is the bitmap or a directory
     ~OpenFile();			// Close the file
 
     void Seek(int position); 		// Set the position from which to 
@@ -87,8 +96,18 @@ class OpenFile {
 					// end of file, tell, lseek back 
     
   private:
-    FileHeader *hdr;			// Header for this file 
+    Vnode *vnode;			// The file, shared with its other
+					// openers (see vnode.h)
+    FileHeader *hdr;			// Header for this file (vnode->hdr)
     int seekPosition;			// Current position within the file
+
+    int nextSequential;			// where the next read starts, if
+					// the reader is going sequentially
+    int readAhead;			// # of sectors to read ahead, or 0
+    int prefetchedTo;			// # of the first file sector not yet
+					// read ahead
+    void ReadAheadFrom(int fileSector);	// start reading the sectors after
+					// those just read
 };
 
 #endif // FILESYS
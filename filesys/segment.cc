@@ -0,0 +1,236 @@
+// segment.cc
+//	Routines to manage the log of segments, when the file system is
+//	log-structured.  See segment.h for an overview.
+//
+//	Moving sectors is up to the file system (see
+//	FileSystem::RelocateSector and FileSystem::CleanSegments); here
+//	we only keep track of where the log is, and which segments are
+//	worth cleaning.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "segment.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// SegmentCleaner
+// 	The cleaner thread.  Each time the log runs short of clean
+//	segments, clean some.
+//----------------------------------------------------------------------
+
+static void
+SegmentCleaner(int arg)
+{
+    SegmentLog *log = (SegmentLog *) arg;
+
+    for (;;) {
+	log->cleanWanted->P();
+	fileSystem->CleanSegments();
+    }
+}
+
+//----------------------------------------------------------------------
+// SegmentLog::SegmentLog
+// 	Start the log at the first clean segment (or the first segment
+//	after the fixed metadata, if none is clean), and fork the cleaner
+//	thread.  No owners are known yet.
+//
+//	"map" -- the bitmap of free sectors, kept up to date by the
+//		file system
+//----------------------------------------------------------------------
+
+SegmentLog::SegmentLog(BitMap *map)
+{
+    Thread *cleaner;
+
+    freeMap = map;
+    for (int i = 0; i < NumSectors; i++)
+	owners[i] = -1;
+    for (segment = FirstSegment; segment < NumSegments; segment++)
+	if (NumLive(segment) == 0)
+	    break;
+    if (segment == NumSegments)
+	segment = FirstSegment;
+    head = segment * SegmentSize;
+    cleaning = ownersKnown = FALSE;
+    cleanWanted = new Semaphore("segment cleaner", 0);
+
+    cleaner = new Thread("segment cleaner");
+    cleaner->Fork(SegmentCleaner, (void *) this);
+}
+
+//----------------------------------------------------------------------
+// SegmentLog::~SegmentLog
+// 	De-allocate the log.  The cleaner thread is left asleep; this is
+//	only done when Nachos halts.
+//----------------------------------------------------------------------
+
+SegmentLog::~SegmentLog()
+{
+}
+
+//----------------------------------------------------------------------
+// SegmentLog::Head
+// 	Return the first free sector in the segment being filled.  If
+//	there isn't one, write the segment back, in one run, and go on to
+//	the next clean segment -- or, if no segment is clean, to the one
+//	with the most free sectors.  If that leaves few clean segments,
+//	wake the cleaner.
+//
+//	Writing the segment back may put us to sleep.
+//----------------------------------------------------------------------
+
+int
+SegmentLog::Head()
+{
+    int end = (segment + 1) * SegmentSize;
+    int full = segment, best = -1, bestLive = SegmentSize, live, seg;
+
+    while ((head < end) && freeMap->Test(head))
+	head++;
+    if (head == end) {
+	for (int i = 1; i < NumSegments - FirstSegment; i++) {
+	    seg = FirstSegment
+		+ (segment - FirstSegment + i) % (NumSegments - FirstSegment);
+	    live = NumLive(seg);
+	    if (live < bestLive) {
+		best = seg;
+		bestLive = live;
+	    }
+	    if (live == 0)
+		break;
+	}
+	if (best != -1) {
+	    DEBUG('f', "Log moves on to segment %d, %d sectors in use\n",
+			best, bestLive);
+	    segment = best;
+	    head = segment * SegmentSize;
+	    while (freeMap->Test(head))
+		head++;
+	}
+	bufferCache->WriteRun(full * SegmentSize, SegmentSize);
+    }
+    if ((NumClean() < CleanLow) && !cleaning) {
+	cleaning = TRUE;
+	cleanWanted->V();
+    }
+    return head;
+}
+
+//----------------------------------------------------------------------
+// SegmentLog::Allocate
+// 	Allocate a sector at the head of the log, and note the file it
+//	belongs to.  If the segment being filled is full, and there isn't
+//	another with a free sector, any free sector will do.  Return -1
+//	if the disk is full.
+//
+//	"owner" -- the sector of the file's header
+//----------------------------------------------------------------------
+
+int
+SegmentLog::Allocate(int owner)
+{
+    int sector = freeMap->FindRun(1, SegmentSize, Head());
+
+    if (sector != -1)
+	owners[sector] = owner;
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// SegmentLog::Allocated
+// 	Note the owner of the sectors a file has just been given, from
+//	"fromSector" to the end of the file.
+//
+//	"hdr" -- the file's header
+//	"owner" -- the sector of the file's header
+//	"fromSector" -- the first of the file's new sectors
+//----------------------------------------------------------------------
+
+void
+SegmentLog::Allocated(FileHeader *hdr, int owner, int fromSector)
+{
+    for (int i = fromSector; i < hdr->NumDataSectors(); i++)
+	owners[hdr->ByteToSector(i * SectorSize)] = owner;
+}
+
+//----------------------------------------------------------------------
+// SegmentLog::Sync
+// 	Write back what has been written to the segment being filled, in
+//	as few runs as possible.
+//----------------------------------------------------------------------
+
+void
+SegmentLog::Sync()
+{
+    bufferCache->WriteRun(segment * SegmentSize, SegmentSize);
+}
+
+//----------------------------------------------------------------------
+// SegmentLog::NumLive
+// 	Return the number of sectors in use in a segment.
+//
+//	"seg" -- which segment
+//----------------------------------------------------------------------
+
+int
+SegmentLog::NumLive(int seg)
+{
+    int live = 0;
+
+    for (int i = seg * SegmentSize; i < (seg + 1) * SegmentSize; i++)
+	if (freeMap->Test(i))
+	    live++;
+    return live;
+}
+
+//----------------------------------------------------------------------
+// SegmentLog::NumClean
+// 	Return the number of segments in the log with no sectors in use,
+//	besides the one being filled.
+//----------------------------------------------------------------------
+
+int
+SegmentLog::NumClean()
+{
+    int clean = 0;
+
+    for (int seg = FirstSegment; seg < NumSegments; seg++)
+	if ((seg != segment) && (NumLive(seg) == 0))
+	    clean++;
+    return clean;
+}
+
+//----------------------------------------------------------------------
+// SegmentLog::Victim
+// 	Pick the segment to clean next: the one with the fewest sectors
+//	still in use, so that the fewest have to be moved.  Segments that
+//	are clean already, or full, or being filled, are left alone; and
+//	so are those tried already, in case their sectors can't be moved.
+//	Return -1 if there is nothing to clean.
+//
+//	"tried" -- which segments have been tried; the one picked is
+//		added
+//----------------------------------------------------------------------
+
+int
+SegmentLog::Victim(bool *tried)
+{
+    int best = -1, bestLive = SegmentSize, live;
+
+    for (int seg = FirstSegment; seg < NumSegments; seg++) {
+	if ((seg == segment) || tried[seg])
+	    continue;
+	live = NumLive(seg);
+	if ((live > 0) && (live < bestLive)) {
+	    best = seg;
+	    bestLive = live;
+	}
+    }
+    if (best != -1)
+	tried[best] = TRUE;
+    return best;
+}
@@ -0,0 +1,100 @@
+// segment.h
+//	Data structures for writing the file system as a log, when the
+//	disk is formatted in log-structured mode (nachos -f -lfs).
+//
+//	The disk is divided into segments, a track each.  The data of
+//	files is never written back in place: a data sector that is
+//	written goes to a new sector at the "head" of the log, in the
+//	segment being filled, and the file header is changed to point
+//	there (see FileHeader::Replace).  New sectors for a growing file
+//	are taken at the head, too.  So however a file is written, the
+//	writes land one after another on the same track, and each segment
+//	can be written back a run at a time (BufferCache::WriteRun)
+//	instead of a sector at a time.  The metadata is not moved; it is
+//	appended to the log of the journal instead (see journal.h).
+//
+//	When a segment is full, the head moves on to the next segment
+//	that is completely free ("clean").  The sectors left behind in
+//	older segments leave holes there; a cleaner thread, woken when
+//	few segments are clean, picks the segment with the fewest sectors
+//	still in use, and moves them to the head, so that it is clean
+//	again.
+//
+//	To move a sector, the cleaner has to know which file it belongs
+//	to.  That is kept in memory only: the owner of each data sector
+//	written since Nachos started is noted as it is allocated, and the
+//	rest are found by walking the directories, the first time the
+//	cleaner runs.  An owner is only a hint; the file's header is
+//	checked before anything is moved.
+//
+//      We assume mutual exclusion is provided by the caller.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include "disk.h"
+#include "bitmap.h"
+#include "filehdr.h"
+#include "journal.h"
+#include "synch.h"
+
+#define SegmentSize	SectorsPerTrack	// sectors in a segment
+#define NumSegments	(NumSectors / SegmentSize)
+#define FirstSegment	(JournalEnd / SegmentSize)
+					// the segments before this one hold
+					// the fixed metadata and the journal
+#define CleanLow	3		// wake the cleaner when fewer than
+					// this many segments are clean
+#define CleanHigh	6		// and clean until this many are
+
+// The following class defines the log of segments.
+class SegmentLog {
+  public:
+    SegmentLog(BitMap *freeMap);	// Start at the first clean segment,
+					// and fork the cleaner thread
+    ~SegmentLog();
+
+    int Head();				// Where the next sector of the log
+					// goes; moves on to a clean segment
+					// if this one is full
+    int Allocate(int owner);		// Allocate the sector at the head,
+					// for the file whose header is at
+					// "owner"; -1 if the disk is full
+    void Allocated(FileHeader *hdr, int owner, int fromSector);
+					// Note the sectors a file has taken
+					// at the head, from file sector
+					// "fromSector" on
+    bool IsCurrent(int sector) { return sector / SegmentSize == segment; }
+					// Is it in the segment being filled?
+    void Sync();			// Write back the segment being filled
+
+    void SetOwner(int sector, int owner) { owners[sector] = owner; }
+					// Note whose sector it is; a file's
+					// header sector is its own, and -1
+					// means no file's
+    int Owner(int sector) { return owners[sector]; }
+
+    int NumClean();			// # of segments completely free
+    int Victim(bool *tried);		// The segment to clean next, or -1
+
+    Semaphore *cleanWanted;		// the cleaner thread waits on this
+    bool cleaning;			// has it been woken, and not done?
+    bool ownersKnown;			// have the directories been walked?
+
+  private:
+    BitMap *freeMap;			// which sectors are in use
+    int segment;			// the segment being filled
+    int head;				// where in it to look for a free sector
+    int owners[NumSectors];		// header sector of the file each
+					// sector belongs to, or -1
+
+    int NumLive(int seg);		// # of sectors in use in a segment
+};
+
+#endif // SEGMENT_H
@@ -5,10 +5,11 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Each request has its own semaphore, to synchronize the interrupt
+//	handler with the thread waiting for that request.  Requests either
+//	all go straight to the disk, which queues them itself, or wait 
+//	here to be sent one at a time in the order a scheduling policy 
+//	picks (see synchdisk.h).
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,19 +17,38 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "system.h"
 
 //----------------------------------------------------------------------
 // DiskRequestDone
 // 	Disk interrupt handler.  Need this to be a C routine, because 
 //	C++ can't handle pointers to member functions.
+//
+//	"arg" -- the request that completed
 //----------------------------------------------------------------------
 
 static void
 DiskRequestDone (int arg)
 {
-    SynchDisk* disk = (SynchDisk *)arg;
+    PendingRequest* request = (PendingRequest *)arg;
+
+    request->owner->RequestDone(request);
+}
+
+//----------------------------------------------------------------------
+// RequestWaiterDone
+// 	Completion routine for a synchronous request: wake up the thread
+//	waiting for it.
+//
+//	"arg" -- the semaphore the thread is waiting on
+//----------------------------------------------------------------------
+
+static void
+RequestWaiterDone (int arg)
+{
+    Semaphore* done = (Semaphore *)arg;
 
-    disk->RequestDone();
+    done->V();
 }
 
 //----------------------------------------------------------------------
@@ -38,13 +58,16 @@ DiskRequestDone (int arg)
 //
 //	"name" -- UNIX file name to be used as storage for the disk data
 //	   (usually, "DISK")
+//	"policy" -- the order to send waiting requests to the disk in
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk(char* name)
+SynchDisk::SynchDisk(char* name, DiskPolicy diskPolicy)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
-    disk = new Disk(name, DiskRequestDone, (int) this);
+    disk = new Disk(name, NULL, 0);
+    policy = diskPolicy;
+    pending = pendingTail = NULL;
+    busy = FALSE;
+    sweepingUp = TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -56,8 +79,31 @@ SynchDisk::SynchDisk(char* name)
 SynchDisk::~SynchDisk()
 {
     delete disk;
-    delete lock;
-    delete semaphore;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::PolicyNamed
+// 	Find the disk scheduling policy with a given name.  Returns FALSE
+//	if there isn't one.
+//
+//	"name" -- one of "queue", "fcfs", "sstf", "scan", "clook", "deadline"
+//	"policy" -- where to put the answer
+//----------------------------------------------------------------------
+
+bool
+SynchDisk::PolicyNamed(char *name, DiskPolicy *policy)
+{
+    static char *names[] = { "queue", "fcfs", "sstf", "scan", "clook",
+				"deadline" };
+    static DiskPolicy policies[] = { DiskQueue, FCFS, SSTF, SCAN, CLOOK,
+				Deadline };
+
+    for (int i = 0; i < (int) (sizeof(names) / sizeof(names[0])); i++)
+	if (!strcmp(name, names[i])) {
+	    *policy = policies[i];
+	    return TRUE;
+	}
+    return FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -72,10 +118,7 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    Request(sectorNumber, data, FALSE, 1);
 }
 
 //----------------------------------------------------------------------
@@ -90,20 +133,314 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    Request(sectorNumber, data, TRUE, 1);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadSectors/WriteSectors
+// 	Read/write a run of consecutive disk sectors.  Return only after
+//	all of them have been transferred.
+//
+//	The run is split at track boundaries, and each piece is a single
+//	request to the disk: once the head reaches the first sector of a
+//	piece, the rest follow at one sector per RotationTime, rather than
+//	each paying its own rotational delay.
+//
+//	"sectorNumber" -- the first disk sector
+//	"numSectors" -- how many sectors
+//	"data" -- the buffer, numSectors * SectorSize bytes long
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadSectors(int sectorNumber, int numSectors, char* data)
+{
+    Transfer(sectorNumber, numSectors, data, FALSE);
+}
+
+void
+SynchDisk::WriteSectors(int sectorNumber, int numSectors, char* data)
+{
+    Transfer(sectorNumber, numSectors, data, TRUE);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadTrack
+// 	Read a whole track.
+//
+//	"track" -- which track
+//	"data" -- the buffer, SectorsPerTrack * SectorSize bytes long
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadTrack(int track, char* data)
+{
+    ASSERT((track >= 0) && (track < NumTracks));
+    Request(track * SectorsPerTrack, data, FALSE, SectorsPerTrack);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Transfer
+// 	Read or write a run of sectors, one track's worth at a time.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Transfer(int sectorNumber, int numSectors, char* data, 
+		    bool writing)
+{
+    int count;
+
+    ASSERT((sectorNumber >= 0) && (sectorNumber + numSectors <= NumSectors));
+    while (numSectors > 0) {
+	count = SectorsPerTrack - (sectorNumber % SectorsPerTrack);
+	if (count > numSectors)
+	    count = numSectors;
+	Request(sectorNumber, data, writing, count);
+	sectorNumber += count;
+	data += count * SectorSize;
+	numSectors -= count;
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::StartRead
+// 	Start reading the contents of a disk sector into a buffer, without
+//	waiting for it.  Used to read ahead of what a thread has asked for.
+//
+//	"sectorNumber" -- the disk sector to read
+//	"data" -- the buffer to hold the contents of the disk sector;
+//		must stay put until the read completes
+//	"callWhenDone", "callArg" -- (*callWhenDone)(callArg) is called,
+//		from the disk interrupt handler, when the read completes
+//----------------------------------------------------------------------
+
+void
+SynchDisk::StartRead(int sectorNumber, char* data, 
+		     VoidFunctionPtr callWhenDone, int callArg)
+{
+    PendingRequest *request = new PendingRequest;
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    request->sector = sectorNumber;
+    request->count = 1;
+    request->data = data;
+    request->writing = FALSE;
+    request->callWhenDone = callWhenDone;
+    request->callArg = callArg;
+    request->async = TRUE;
+    Enqueue(request);
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Request
+// 	Make a request to read or write "count" sectors of one track, and
+//	wait for it to complete.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Request(int sectorNumber, char* data, bool writing, int count)
+{
+    Semaphore done((char *) (writing ? "synch disk write" : "synch disk read"),
+		   0);
+    PendingRequest request;
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    request.sector = sectorNumber;
+    request.count = count;
+    request.data = data;
+    request.writing = writing;
+    request.callWhenDone = RequestWaiterDone;
+    request.callArg = (int) &done;
+    request.async = FALSE;
+    Enqueue(&request);
+    (void) interrupt->SetLevel(oldLevel);
+    done.P();				// wait for interrupt
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Enqueue
+// 	With the DiskQueue policy, send a request straight to the disk,
+//	unless the disk's queue is full (then it waits here, behind any
+//	others waiting, until the disk finishes one); otherwise, it waits
+//	its turn here.  Called with interrupts off.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Enqueue(PendingRequest *request)
+{
+    request->owner = this;
+    request->arrival = stats->totalTicks;
+    request->deadline = stats->totalTicks 
+		+ (request->writing ? DiskWriteDeadline : DiskReadDeadline);
+    request->next = NULL;
+
+    if ((policy == DiskQueue) && (pending == NULL) 
+		&& (disk->NumQueued() < MaxDiskRequests)) {
+	disk->QueueRequest(request->sector, request->data, request->writing,
+			   DiskRequestDone, (int) request, request->count);
+	return;
+    }
+    if (pendingTail == NULL)
+	pending = request;
+    else
+	pendingTail->next = request;
+    pendingTail = request;
+    if (CanDispatch())
+	Dispatch();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::CanDispatch
+// 	Return TRUE if the disk can be sent another request: under the
+//	DiskQueue policy, if its queue has room; otherwise, if it has
+//	nothing to do.
+//----------------------------------------------------------------------
+
+bool
+SynchDisk::CanDispatch()
+{
+    if (policy == DiskQueue)
+	return disk->NumQueued() < MaxDiskRequests;
+    return !busy;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::NumQueued
+// 	Return how many requests are outstanding: those the disk has, and
+//	those still waiting here to be sent to it.
+//----------------------------------------------------------------------
+
+int
+SynchDisk::NumQueued()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    int num = disk->NumQueued();
+
+    for (PendingRequest *r = pending; r != NULL; r = r->next)
+	num++;
+    (void) interrupt->SetLevel(oldLevel);
+    return num;
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::RequestDone
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// 	Disk interrupt handler.  Tell whoever made the request that it
+//	is finished, and send the disk the next request.
+//
+//	"request" -- the request that completed
 //----------------------------------------------------------------------
 
 void
-SynchDisk::RequestDone()
+SynchDisk::RequestDone(PendingRequest *request)
 { 
-    semaphore->V();
+    int ticks = stats->totalTicks - request->arrival;
+
+    stats->diskRequestTicks += ticks;
+    if (ticks > stats->maxDiskRequestTicks)
+	stats->maxDiskRequestTicks = ticks;
+    busy = FALSE;
+    (*request->callWhenDone)(request->callArg);
+    if (request->async)
+	delete request;		// otherwise it goes away once its thread runs
+    if ((pending != NULL) && CanDispatch())
+	Dispatch();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Dispatch
+// 	Send the request the policy likes best to the disk (under the
+//	DiskQueue policy, the one that has waited longest).
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Dispatch()
+{
+    PendingRequest *prev, *request = PickNext(&prev);
+
+    ASSERT(request != NULL);		// the oldest is always a candidate
+    if (prev == NULL)
+	pending = request->next;
+    else
+	prev->next = request->next;
+    if (pendingTail == request)
+	pendingTail = prev;
+    request->next = NULL;
+
+    busy = TRUE;
+    disk->QueueRequest(request->sector, request->data, request->writing,
+		       DiskRequestDone, (int) request, request->count);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::PickNext
+// 	Choose the next waiting request, according to the policy and the
+//	position of the head.  A request can't be chosen ahead of an
+//	earlier one for any of the same sectors.
+//
+//	"prevPtr" -- set to the request before the one chosen, or NULL
+//----------------------------------------------------------------------
+
+PendingRequest *
+SynchDisk::PickNext(PendingRequest **prevPtr)
+{
+    PendingRequest *r, *prev, *earlier;
+    PendingRequest *ahead = NULL, *aheadPrev = NULL;	// closest in the
+							// sweep direction
+    PendingRequest *closest = NULL, *closestPrev = NULL; // closest at all
+    PendingRequest *lowest = NULL, *lowestPrev = NULL;	// lowest sector
+    int head = disk->LastSector();
+    int distance, aheadDistance = 0, closestDistance = 0;
+    bool up = (policy != SCAN) || sweepingUp;
+
+    for (prev = NULL, r = pending; r != NULL; prev = r, r = r->next) {
+	for (earlier = pending; earlier != r; earlier = earlier->next)
+	    if ((earlier->sector < r->sector + r->count)
+		    && (r->sector < earlier->sector + earlier->count))
+		break;
+	if (earlier != r)
+	    continue;			// must wait for the earlier one
+
+	if (policy == FCFS || policy == DiskQueue || (policy == Deadline 
+				&& r->deadline <= stats->totalTicks)) {
+	    *prevPtr = prev;		// the oldest (expired) request
+	    return r;
+	}
+	distance = abs(r->sector - head);
+	if (closest == NULL || distance < closestDistance) {
+	    closest = r;
+	    closestPrev = prev;
+	    closestDistance = distance;
+	}
+	if ((up ? (r->sector >= head) : (r->sector <= head))
+		&& (ahead == NULL || distance < aheadDistance)) {
+	    ahead = r;
+	    aheadPrev = prev;
+	    aheadDistance = distance;
+	}
+	if (lowest == NULL || r->sector < lowest->sector) {
+	    lowest = r;
+	    lowestPrev = prev;
+	}
+    }
+
+    switch (policy) {
+      case SSTF:
+	*prevPtr = closestPrev;
+	return closest;
+      case SCAN:
+	if (ahead == NULL) {		// nothing left in this direction,
+	    sweepingUp = !sweepingUp;	// so turn around
+	    *prevPtr = closestPrev;
+	    return closest;
+	}
+	break;
+      default:				// C-LOOK, or deadline with none
+	if (ahead == NULL) {		// expired: jump back to the start
+	    *prevPtr = lowestPrev;
+	    return lowest;
+	}
+	break;
+    }
+    *prevPtr = aheadPrev;
+    return ahead;
 }
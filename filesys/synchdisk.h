@@ -14,19 +14,62 @@
 #include "disk.h"
 #include "synch.h"
 
+// The order in which waiting requests are sent to the disk.
+//
+//	DiskQueue -- send them all at once (as many as the disk can
+//		queue), and let the disk choose
+//	FCFS -- first come, first served
+//	SSTF -- shortest seek time first: the request nearest the head
+//	SCAN -- the elevator algorithm: sweep the head up, then back down,
+//		serving requests in passing
+//	CLOOK -- circular LOOK: sweep only upwards, then jump back to
+//		the lowest request
+//	Deadline -- C-LOOK, but a request that has waited too long 
+//		(DiskReadDeadline or DiskWriteDeadline) goes first
+
+enum DiskPolicy { DiskQueue, FCFS, SSTF, SCAN, CLOOK, Deadline };
+
+#define DiskReadDeadline	50000	// ticks a read may wait
+#define DiskWriteDeadline	250000	// ticks a write may wait
+
+class SynchDisk;
+
+// A request waiting for the disk, or in progress.
+class PendingRequest {
+  public:
+    SynchDisk *owner;			// the disk it is for
+    int sector;				// which sector to read or write
+    int count;				// # of sectors, all on one track
+    char *data;				// where the data comes from/goes to
+    bool writing;			// is it a write?
+    int arrival;			// when the request was made
+    int deadline;			// when it must be sent to the disk,
+					// under the Deadline policy
+    VoidFunctionPtr callWhenDone;	// call (*callWhenDone)(callArg)
+    int callArg;			// when the request completes
+    bool async;				// no one waits; delete when done
+    PendingRequest *next;		// the next request, in arrival order
+};
+
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
 // requests to read or write portions of the disk return immediately,
 // and an interrupt occurs later to signal that the operation completed.
-// (Also, the physical characteristics of the disk device assume that
-// only one operation can be requested at a time).
+// The disk can have several requests outstanding at once.
 //
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
-// returning.
+// returning.  
+//
+// Unless the policy is DiskQueue, requests wait here, and are sent to
+// the disk one at a time, in the order the policy picks.  Under
+// DiskQueue, they only wait here when the disk's queue is full, and
+// are then sent in the order they were made.  In every case, requests
+// for the same sector are done in the order they were made.
 class SynchDisk {
   public:
-    SynchDisk(char* name);    		// Initialize a synchronous disk,
+    SynchDisk(char* name, DiskPolicy policy = DiskQueue);
+    					// Initialize a synchronous disk,
 					// by initializing the raw Disk.
     ~SynchDisk();			// De-allocate the synch disk data
     
@@ -34,20 +77,50 @@ class SynchDisk {
     					// Read/write a disk sector, returning
     					// only once the data is actually read 
 					// or written.  These call
-    					// Disk::ReadRequest/WriteRequest and
-					// then wait until the request is done.
+    					// Disk::QueueRequest and then wait 
+					// until the request is done.
     void WriteSector(int sectorNumber, char* data);
-    
-    void RequestDone();			// Called by the disk device interrupt
-					// handler, to signal that the
-					// current disk operation is complete.
+
+    void ReadSectors(int sectorNumber, int numSectors, char* data);
+    void WriteSectors(int sectorNumber, int numSectors, char* data);
+					// Read/write a run of consecutive
+					// sectors, track by track
+    void ReadTrack(int track, char* data);
+					// Read all the sectors of a track
+
+    void StartRead(int sectorNumber, char* data, 
+		   VoidFunctionPtr callWhenDone, int callArg);
+					// Start reading a sector, but return
+					// at once; call (*callWhenDone)(callArg)
+					// from the interrupt handler once the
+					// data is there
+
+    void RequestDone(PendingRequest *request);
+					// Called by the disk device interrupt
+					// handler, when a request completes
+
+    int NumQueued();			// # of requests outstanding, at the
+					// disk or waiting for it
+
+    static bool PolicyNamed(char *name, DiskPolicy *policy);
+					// Parse a policy name, eg "clook"
 
   private:
     Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+    DiskPolicy policy;			// how to order requests
+    PendingRequest *pending;		// requests not yet sent to the disk,
+    PendingRequest *pendingTail;	// in arrival order
+    bool busy;				// is a request at the disk?
+    bool sweepingUp;			// SCAN: which way the head is going
+
+    void Request(int sectorNumber, char* data, bool writing, int count);
+    void Transfer(int sectorNumber, int numSectors, char* data, 
+		  bool writing);		// split a run into requests
+    void Enqueue(PendingRequest *request);	// send it or queue it
+    bool CanDispatch();			// can the disk take another one?
+    void Dispatch();			// send the next request to the disk
+    PendingRequest *PickNext(PendingRequest **prevPtr);
+					// which request the policy wants
 };
 
 #endif // SYNCHDISK_H
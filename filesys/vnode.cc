@@ -0,0 +1,336 @@
+// vnode.cc
+//	Routines to manage the table of open files' headers.  See vnode.h
+//	for an overview.
+//
+//	Reading a header in, or writing it back, may put the thread to
+//	sleep; so Get checks again afterwards whether someone else has
+//	opened the file meanwhile.  Put keeps the last reference while it
+//	finishes with the file, so that no one else does too; if the
+//	file is reopened meanwhile, the last of the new openers finishes
+//	with it instead.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "vnode.h"
+#include "system.h"
+#include <strings.h>
+
+//----------------------------------------------------------------------
+// Vnode::Vnode
+// 	Initialize a vnode, reading in the file header.  There are no
+//	references to it yet.
+//
+//	"hdrSector" -- the location on disk of the file header
+//----------------------------------------------------------------------
+
+Vnode::Vnode(int hdrSector)
+{
+    sector = hdrSector;
+    hdr = new FileHeader;
+    hdr->FetchFrom(sector);
+    refCount = 0;
+    dirty = removed = closing = freed = metadata = FALSE;
+    growWindow = MinGrowWindow;
+    pendingSector = -1;
+    hashNext = NULL;
+}
+
+//----------------------------------------------------------------------
+// Vnode::~Vnode
+// 	De-allocate a vnode.
+//----------------------------------------------------------------------
+
+Vnode::~Vnode()
+{
+    delete hdr;
+}
+
+//----------------------------------------------------------------------
+// Vnode::Grow
+// 	Make the file "newLength" bytes long, allocating more sectors if
+//	need be.  Sectors are allocated a batch at a time, and the batches
+//	get bigger as long as the file keeps growing, so that a file
+//	written a little at a time still ends up in long runs, without
+//	going to the free map for every sector.
+//
+//	If there isn't space for "newLength" bytes, make the file as long
+//	as the sectors it has allow, and return FALSE.
+//
+//	A metadata file's header is written back at once, in the same
+//	transaction as the bitmap; it stays dirty, so that the sectors
+//	left over are still given back when the file is closed.
+//----------------------------------------------------------------------
+
+bool
+Vnode::Grow(int newLength)
+{
+    int needed = hdr->SectorsNeeded(newLength);
+    bool success = TRUE;
+
+    if (needed > 0) {
+	if (fileSystem->ExtendFile(hdr, sector,
+		(needed > growWindow) ? needed : growWindow, !metadata)
+	    || fileSystem->ExtendFile(hdr, sector, needed, !metadata)) {
+	    dirty = TRUE;
+	    if (growWindow < MaxGrowWindow)
+		growWindow *= 2;
+	} else {
+	    newLength = hdr->SpaceLength();
+	    success = FALSE;
+	}
+    }
+    if (newLength > hdr->FileLength()) {
+	hdr->SetLength(newLength);
+	dirty = TRUE;
+    }
+    if (metadata && dirty)
+	hdr->WriteBack(sector);
+    return success;
+}
+
+//----------------------------------------------------------------------
+// Vnode::WritePartial
+// 	Write part of one sector.  If the bytes continue (or overlap) the
+//	ones already pending for the sector, add them on; otherwise, send
+//	what is pending to the cache, and start again with these.  Once
+//	the whole sector has been written, send it on, without reading
+//	the old contents.  A metadata file's bytes are sent on at once.
+//
+//	"from" -- the bytes to write
+//	"numBytes" -- how many; they must all be in one sector
+//	"position" -- where in the file they go
+//----------------------------------------------------------------------
+
+void
+Vnode::WritePartial(char *from, int numBytes, int position)
+{
+    int fileSector = divRoundDown(position, SectorSize);
+    int offset = position - fileSector * SectorSize;
+
+    ASSERT(offset + numBytes <= SectorSize);
+    if ((fileSector == pendingSector) && (offset <= pendingTo)
+		&& (offset + numBytes >= pendingFrom)) {
+	if (offset < pendingFrom)
+	    pendingFrom = offset;
+	if (offset + numBytes > pendingTo)
+	    pendingTo = offset + numBytes;
+    } else {
+	FlushPending();
+	pendingSector = fileSector;
+	pendingFrom = offset;
+	pendingTo = offset + numBytes;
+    }
+    bcopy(from, &pending[offset], numBytes);
+    if (metadata || ((pendingFrom == 0) && (pendingTo == SectorSize)))
+	FlushPending();
+}
+
+//----------------------------------------------------------------------
+// Vnode::FlushPending
+// 	Put the bytes kept in "pending" into their sector, in the buffer
+//	cache.  Unless they cover the whole sector, the rest of it has to
+//	be read first -- except when the rest is past the end of the
+//	file, as when a file is being written at the end a little at a
+//	time; then we clear the rest instead.
+//----------------------------------------------------------------------
+
+void
+Vnode::FlushPending()
+{
+    bool atEnd, overwrite;
+    int diskSector;
+    char *data;
+
+    if (pendingSector < 0)
+	return;
+    atEnd = (pendingFrom == 0) &&
+		(pendingSector * SectorSize + pendingTo >= hdr->FileLength());
+    overwrite = atEnd || ((pendingFrom == 0) && (pendingTo == SectorSize));
+    if (metadata) {
+	diskSector = hdr->ByteToSector(pendingSector * SectorSize);
+	journal->Log(diskSector, overwrite);
+    } else
+	diskSector = Relocate(pendingSector, overwrite);
+    data = bufferCache->Pin(diskSector, overwrite);
+    bcopy(&pending[pendingFrom], &data[pendingFrom], pendingTo - pendingFrom);
+    if (atEnd)
+	bzero(&data[pendingTo], SectorSize - pendingTo);
+    bufferCache->Unpin(data, TRUE);
+    pendingSector = -1;
+}
+
+//----------------------------------------------------------------------
+// Vnode::Relocate
+// 	Return the disk sector to write a sector of the file to.  If the
+//	disk is log-structured, this may move the sector to the head of
+//	the log, changing the header.
+//
+//	"fileSector" -- which sector of the file is to be written
+//	"overwrite" -- will the caller set all of it?
+//----------------------------------------------------------------------
+
+int
+Vnode::Relocate(int fileSector, bool overwrite)
+{
+    int diskSector = fileSystem->RelocateSector(hdr, sector, fileSector,
+						overwrite);
+
+    if (hdr->NumReplaced() > 0)
+	dirty = TRUE;
+    return diskSector;
+}
+
+//----------------------------------------------------------------------
+// VnodeTable::VnodeTable
+// 	Initialize an empty table.
+//----------------------------------------------------------------------
+
+VnodeTable::VnodeTable()
+{
+    for (int i = 0; i < VnodeBuckets; i++)
+	buckets[i] = NULL;
+}
+
+//----------------------------------------------------------------------
+// VnodeTable::~VnodeTable
+// 	De-allocate the table, and the vnodes of files still open.
+//----------------------------------------------------------------------
+
+VnodeTable::~VnodeTable()
+{
+    Vnode *v, *next;
+
+    for (int i = 0; i < VnodeBuckets; i++)
+	for (v = buckets[i]; v != NULL; v = next) {
+	    next = v->hashNext;
+	    delete v;
+	}
+}
+
+//----------------------------------------------------------------------
+// VnodeTable::Get
+// 	Return the vnode for a file, adding a reference to it.  If the
+//	file isn't open, read its header in.
+//
+//	"sector" -- the location on disk of the file header
+//----------------------------------------------------------------------
+
+Vnode *
+VnodeTable::Get(int sector)
+{
+    Vnode *v, *fresh = NULL;
+
+    for (;;) {
+	for (v = buckets[sector % VnodeBuckets]; v != NULL; v = v->hashNext)
+	    if (v->sector == sector)
+		break;
+	if (v != NULL) {		// already open
+	    delete fresh;
+	    break;
+	}
+	if (fresh != NULL) {		// still not open, so use ours
+	    v = fresh;
+	    v->hashNext = buckets[sector % VnodeBuckets];
+	    buckets[sector % VnodeBuckets] = v;
+	    break;
+	}
+	fresh = new Vnode(sector);	// may sleep; then look again
+    }
+    v->refCount++;
+    return v;
+}
+
+//----------------------------------------------------------------------
+// VnodeTable::Put
+// 	Drop a reference to a vnode.  When the last one goes, finish
+//	with the file: send its pending bytes to the cache and write
+//	back its header if it changed (giving back the sectors it
+//	doesn't need); or, if it was removed, free its header and data.
+//
+//	That may put us to sleep, so we hold on to the reference until
+//	we are done, with the vnode marked "closing"; anyone who opens
+//	the file meanwhile just adds to it.  If the file was changed or
+//	removed while we slept, and no one else has it open, we finish
+//	again.  A removed file is freed only once, and its vnode is then
+//	taken out of the table at once, since its header sector may be
+//	reused for a new file.
+//
+//	"vnode" -- the vnode, from Get
+//----------------------------------------------------------------------
+
+void
+VnodeTable::Put(Vnode *vnode)
+{
+    ASSERT(vnode->refCount > 0);
+    if (vnode->refCount > 1) {
+	vnode->refCount--;
+	return;
+    }
+    vnode->closing = TRUE;
+    while ((vnode->refCount == 1) && !vnode->freed) {
+	if (vnode->removed) {
+	    vnode->freed = TRUE;
+	    vnode->pendingSector = -1;
+	    fileSystem->FreeFile(vnode->hdr, vnode->sector);
+	    Unhash(vnode);
+	} else if ((vnode->pendingSector >= 0) || vnode->dirty) {
+	    vnode->FlushPending();
+	    if (vnode->dirty) {
+		vnode->dirty = FALSE;
+		fileSystem->CloseFile(vnode->hdr, vnode->sector);
+	    }
+	} else
+	    break;
+    }
+    vnode->closing = FALSE;
+    if (--vnode->refCount > 0)
+	return;				// opened again while we slept
+
+    if (!vnode->freed)
+	Unhash(vnode);
+    delete vnode;
+}
+
+//----------------------------------------------------------------------
+// VnodeTable::Unhash
+// 	Take a vnode out of the table, so that Get no longer finds it.
+//
+//	"vnode" -- the vnode, which must be in the table
+//----------------------------------------------------------------------
+
+void
+VnodeTable::Unhash(Vnode *vnode)
+{
+    Vnode **ptr;
+
+    for (ptr = &buckets[vnode->sector % VnodeBuckets]; *ptr != vnode;
+					ptr = &(*ptr)->hashNext)
+	ASSERT(*ptr != NULL);
+    *ptr = vnode->hashNext;
+}
+
+//----------------------------------------------------------------------
+// VnodeTable::Sync
+// 	Send the pending bytes of every open file to the cache, and
+//	write back every header that has changed.  The files stay open.
+//----------------------------------------------------------------------
+
+void
+VnodeTable::Sync()
+{
+    Vnode *v;
+
+    for (int i = 0; i < VnodeBuckets; i++)
+	for (v = buckets[i]; v != NULL; v = v->hashNext) {
+	    if (v->removed)
+		continue;
+	    v->FlushPending();
+	    if (v->dirty) {
+		v->dirty = FALSE;
+		fileSystem->WriteHeader(v->hdr, v->sector);
+	    }
+	}
+}
@@ -0,0 +1,107 @@
+// vnode.h
+//	Data structures for the table of open files' headers.
+//
+//	However many times a file is open, there is one "vnode" for it,
+//	holding the only in-memory copy of its file header; every
+//	OpenFile for the file points to it.  So opening a file that is
+//	already open needn't read its header, and when one opener makes
+//	the file longer, the others see it at once.
+//
+//	A header that changes (as the file grows) is only written back
+//	when the last opener closes the file, or on Sync.  A file that is
+//	removed while it is open keeps its sectors until then, too.
+//
+//	The vnode also keeps the bytes written to part of a sector that
+//	haven't gone to the buffer cache yet (see WritePartial), so that
+//	all the openers see them.
+//
+//	The file system's own files -- the bitmap and the directories --
+//	are "metadata": their writes go through the journal (see
+//	journal.h), and so must reach the buffer cache within the
+//	operation that makes them.  Their bytes are never kept pending,
+//	and their headers are written back as soon as they grow.
+//
+//	If the disk is log-structured, other files' sectors may be moved
+//	to the head of the log as they are written (see Relocate); the
+//	header has changed then, too.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef VNODE_H
+#define VNODE_H
+
+#include "disk.h"
+#include "filehdr.h"
+
+#define VnodeBuckets	17		// hash buckets for finding a vnode
+
+// When a write runs past the end of a file, the file grows.  Sectors
+// are allocated in batches, starting with MinGrowWindow sectors and
+// doubling, up to MaxGrowWindow, each time the file needs more; what
+// is left over when the file is closed is given back.
+#define MinGrowWindow	2
+#define MaxGrowWindow	SectorsPerTrack
+
+// The following class defines one open file, shared by all of the
+// OpenFiles for it.
+class Vnode {
+  public:
+    Vnode(int sector);			// Read in the header at "sector"
+    ~Vnode();				// De-allocate the vnode
+
+    bool Grow(int newLength);		// Make the file longer
+    void WritePartial(char *from, int numBytes, int position);
+					// Write within one sector
+    void FlushPending();		// Send "pending" to the cache
+    int Relocate(int fileSector, bool overwrite);
+					// Where to write a sector of the
+					// file (see FileSystem::
+					// RelocateSector)
+
+    int sector;				// Where the header is on disk
+    FileHeader *hdr;			// The header
+    int refCount;			// # of OpenFiles for the file
+    bool dirty;				// Has the header changed since it
+					// was read or written?
+    bool removed;			// Has the file been removed?
+    bool closing;			// Is the last opener finishing with
+					// the file? (see VnodeTable::Put)
+    bool freed;				// Have its sectors been given back?
+    bool metadata;			// Is it the bitmap or a directory?
+    int growWindow;			// # of sectors to allocate next time
+					// the file grows
+
+    char pending[SectorSize];		// bytes written to part of a sector,
+    int pendingSector;			// not yet sent to the cache: which
+    int pendingFrom, pendingTo;		// file sector (or -1), and which bytes
+
+    Vnode *hashNext;			// next vnode in the same bucket
+};
+
+// The following class defines the table of vnodes, by header sector.
+class VnodeTable {
+  public:
+    VnodeTable();			// Initialize an empty table
+    ~VnodeTable();			// De-allocate the table; call Sync
+					// first
+
+    Vnode *Get(int sector);		// Return the vnode for the header
+					// at "sector", reading it in if the
+					// file isn't open; add a reference
+    void Put(Vnode *vnode);		// Drop a reference; on the last one,
+					// write back the header (or free
+					// the file, if it was removed)
+    void Sync();			// Write back all the headers that
+					// have changed
+
+  private:
+    Vnode *buckets[VnodeBuckets];	// hash table, by sector
+
+    void Unhash(Vnode *vnode);		// Take a vnode out of the table
+};
+
+#endif // VNODE_H
@@ -0,0 +1,420 @@
+// blocksim.cc
+//	Routines to simulate a user program a basic block at a time,
+//	rather than an instruction at a time (cf. mipssim.cc).
+//
+//	The simulated behavior is exactly the same as Machine::Run: each
+//	instruction takes UserTick, and interrupts fire at exactly the
+//	same simulated time.  The only difference is that we don't ask
+//	the interrupt simulation whether anything is due after every
+//	instruction; it tells us (Interrupt::NextDue) the earliest time
+//	anything could be, so we only call it then, or when we trap into
+//	the kernel.
+//
+//	Only the most common instructions have their own handler; the
+//	rest are run by Machine::ExecuteInstruction, so the semantics of
+//	the two interpreters can't drift apart.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#include "machine.h"
+#include "opcodes.h"
+#include "blocksim.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// BasicBlock::BasicBlock, BasicBlock::~BasicBlock
+// 	Allocate and de-allocate the instructions in a basic block.
+//----------------------------------------------------------------------
+
+BasicBlock::BasicBlock(int length)
+{
+    numOps = length;
+    ops = new BlockOp[length];
+    valid = TRUE;
+}
+
+BasicBlock::~BasicBlock()
+{
+    delete [] ops;
+}
+
+//----------------------------------------------------------------------
+// Retire
+// 	Finish off an instruction the same way Machine::ExecuteInstruction
+//	does: do any delayed load (cf. Machine::DelayedLoad), and advance
+//	the program counters.
+//
+//	"pcAfter" -- the new value of NextPCReg
+//	"nextLoadReg", "nextLoadValue" -- the delayed load this instruction
+//		started, if any
+//----------------------------------------------------------------------
+
+static inline void
+Retire(int *registers, int pcAfter, int nextLoadReg, int nextLoadValue)
+{
+    registers[registers[LoadReg]] = registers[LoadValueReg];
+    registers[LoadReg] = nextLoadReg;
+    registers[LoadValueReg] = nextLoadValue;
+    registers[0] = 0;	// and always make sure R0 stays zero.
+
+    registers[PrevPCReg] = registers[PCReg];
+    registers[PCReg] = registers[NextPCReg];
+    registers[NextPCReg] = pcAfter;
+}
+
+//----------------------------------------------------------------------
+// Instruction handlers
+//	One for each of the common instructions, each a copy of the
+//	corresponding case in Machine::ExecuteInstruction.
+//
+//	NOTE -- OP_OR is deliberately left to ExecuteInstruction, so that
+//	both interpreters compute the same (odd) result for it.
+//----------------------------------------------------------------------
+
+#define REG(field)	(m->registers[(int) op->instr.field])
+#define NEXTPC		(m->registers[NextPCReg])
+
+static bool
+DoGeneric(Machine *m, BlockOp *op)
+{
+    return m->ExecuteInstruction(&op->instr);
+}
+
+static bool
+DoADDIU(Machine *m, BlockOp *op)
+{
+    REG(rt) = REG(rs) + op->instr.extra;
+    Retire(m->registers, NEXTPC + 4, 0, 0);
+    return TRUE;
+}
+
+static bool
+DoADDU(Machine *m, BlockOp *op)
+{
+    REG(rd) = REG(rs) + REG(rt);
+    Retire(m->registers, NEXTPC + 4, 0, 0);
+    return TRUE;
+}
+
+static bool
+DoSUBU(Machine *m, BlockOp *op)
+{
+    REG(rd) = REG(rs) - REG(rt);
+    Retire(m->registers, NEXTPC + 4, 0, 0);
+    return TRUE;
+}
+
+static bool
+DoAND(Machine *m, BlockOp *op)
+{
+    REG(rd) = REG(rs) & REG(rt);
+    Retire(m->registers, NEXTPC + 4, 0, 0);
+    return TRUE;
+}
+
+static bool
+DoANDI(Machine *m, BlockOp *op)
+{
+    REG(rt) = REG(rs) & (op->instr.extra & 0xffff);
+    Retire(m->registers, NEXTPC + 4, 0, 0);
+    return TRUE;
+}
+
+static bool
+DoORI(Machine *m, BlockOp *op)
+{
+    REG(rt) = REG(rs) | (op->instr.extra & 0xffff);
+    Retire(m->registers, NEXTPC + 4, 0, 0);
+    return TRUE;
+}
+
+static bool
+DoXOR(Machine *m, BlockOp *op)
+{
+    REG(rd) = REG(rs) ^ REG(rt);
+    Retire(m->registers, NEXTPC + 4, 0, 0);
+    return TRUE;
+}
+
+static bool
+DoLUI(Machine *m, BlockOp *op)
+{
+    REG(rt) = op->instr.extra << 16;
+    Retire(m->registers, NEXTPC + 4, 0, 0);
+    return TRUE;
+}
+
+static bool
+DoSLL(Machine *m, BlockOp *op)
+{
+    REG(rd) = REG(rt) << op->instr.extra;
+    Retire(m->registers, NEXTPC + 4, 0, 0);
+    return TRUE;
+}
+
+static bool
+DoSRA(Machine *m, BlockOp *op)
+{
+    REG(rd) = REG(rt) >> op->instr.extra;
+    Retire(m->registers, NEXTPC + 4, 0, 0);
+    return TRUE;
+}
+
+static bool
+DoSLT(Machine *m, BlockOp *op)
+{
+    REG(rd) = (REG(rs) < REG(rt)) ? 1 : 0;
+    Retire(m->registers, NEXTPC + 4, 0, 0);
+    return TRUE;
+}
+
+static bool
+DoSLTI(Machine *m, BlockOp *op)
+{
+    REG(rt) = (REG(rs) < op->instr.extra) ? 1 : 0;
+    Retire(m->registers, NEXTPC + 4, 0, 0);
+    return TRUE;
+}
+
+static bool
+DoSLTU(Machine *m, BlockOp *op)
+{
+    REG(rd) = ((unsigned int) REG(rs) < (unsigned int) REG(rt)) ? 1 : 0;
+    Retire(m->registers, NEXTPC + 4, 0, 0);
+    return TRUE;
+}
+
+static bool
+DoBEQ(Machine *m, BlockOp *op)
+{
+    int pcAfter = NEXTPC + 4;
+
+    if (REG(rs) == REG(rt))
+	pcAfter = NEXTPC + IndexToAddr(op->instr.extra);
+    Retire(m->registers, pcAfter, 0, 0);
+    return TRUE;
+}
+
+static bool
+DoBNE(Machine *m, BlockOp *op)
+{
+    int pcAfter = NEXTPC + 4;
+
+    if (REG(rs) != REG(rt))
+	pcAfter = NEXTPC + IndexToAddr(op->instr.extra);
+    Retire(m->registers, pcAfter, 0, 0);
+    return TRUE;
+}
+
+static bool
+DoJ(Machine *m, BlockOp *op)
+{
+    Retire(m->registers, ((NEXTPC + 4) & 0xf0000000) |
+				IndexToAddr(op->instr.extra), 0, 0);
+    return TRUE;
+}
+
+static bool
+DoJAL(Machine *m, BlockOp *op)
+{
+    m->registers[R31] = NEXTPC + 4;
+    return DoJ(m, op);
+}
+
+static bool
+DoJR(Machine *m, BlockOp *op)
+{
+    Retire(m->registers, REG(rs), 0, 0);
+    return TRUE;
+}
+
+static bool
+DoLW(Machine *m, BlockOp *op)
+{
+    int addr = REG(rs) + op->instr.extra;
+    int value;
+
+    if (addr & 0x3) {
+	m->RaiseException(AddressErrorException, addr);
+	return FALSE;
+    }
+    if (!m->ReadMem(addr, 4, &value))
+	return FALSE;
+    Retire(m->registers, NEXTPC + 4, op->instr.rt, value);
+    return TRUE;
+}
+
+static bool
+DoSW(Machine *m, BlockOp *op)
+{
+    if (!m->WriteMem((unsigned) (REG(rs) + op->instr.extra), 4, REG(rt)))
+	return FALSE;
+    Retire(m->registers, NEXTPC + 4, 0, 0);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// HandlerFor
+// 	Return the routine to execute instructions with opcode "opCode".
+//----------------------------------------------------------------------
+
+static OpHandler
+HandlerFor(int opCode)
+{
+    switch (opCode) {
+      case OP_ADDIU:	return DoADDIU;
+      case OP_ADDU:	return DoADDU;
+      case OP_SUBU:	return DoSUBU;
+      case OP_AND:	return DoAND;
+      case OP_ANDI:	return DoANDI;
+      case OP_ORI:	return DoORI;
+      case OP_XOR:	return DoXOR;
+      case OP_LUI:	return DoLUI;
+      case OP_SLL:	return DoSLL;
+      case OP_SRA:	return DoSRA;
+      case OP_SLT:	return DoSLT;
+      case OP_SLTI:	return DoSLTI;
+      case OP_SLTU:	return DoSLTU;
+      case OP_BEQ:	return DoBEQ;
+      case OP_BNE:	return DoBNE;
+      case OP_J:	return DoJ;
+      case OP_JAL:	return DoJAL;
+      case OP_JR:	return DoJR;
+      case OP_LW:	return DoLW;
+      case OP_SW:	return DoSW;
+      default:		return DoGeneric;
+    }
+}
+
+//----------------------------------------------------------------------
+// IsBranch, IsTrap
+// 	Does an instruction with opcode "opCode" end a basic block?
+//	A branch or jump ends it after its delay slot; a trap ends it
+//	right away.
+//----------------------------------------------------------------------
+
+static bool
+IsBranch(int opCode)
+{
+    switch (opCode) {
+      case OP_BEQ: case OP_BNE: case OP_BGEZ: case OP_BGEZAL:
+      case OP_BGTZ: case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL:
+      case OP_J: case OP_JAL: case OP_JR: case OP_JALR:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+static bool
+IsTrap(int opCode)
+{
+    return (opCode == OP_SYSCALL) || (opCode == OP_RES)
+		|| (opCode == OP_UNIMP);
+}
+
+//----------------------------------------------------------------------
+// Machine::FindBlock
+// 	Return the basic block starting at the current PC, building it if
+//	this is the first time we've been here.
+//
+//	Returns NULL if we can't run a block here, and must fall back on
+//	OneInstruction: if we are about to execute a delay slot (since a
+//	block assumes each instruction follows the one before it), or if
+//	the PC can't be translated (so OneInstruction raises the exception).
+//----------------------------------------------------------------------
+
+BasicBlock *
+Machine::FindBlock()
+{
+    int physicalAddress, first, last, end, i;
+    BasicBlock *block;
+
+    if (registers[NextPCReg] != registers[PCReg] + 4)
+	return NULL;
+    if (Translate(registers[PCReg], &physicalAddress, 4, FALSE)
+							!= NoException)
+	return NULL;
+
+    first = physicalAddress / 4;
+    if (blockCache[first] != NULL)
+	return blockCache[first];
+
+    // find the last instruction: the first trap, the delay slot of the
+    // first branch, or the last word in the page, whichever comes first
+    end = (first / InstrsPerPage + 1) * InstrsPerPage;
+    for (last = first; last < end - 1; last++) {
+	if (!decodeValid[last])
+	    DecodeWord(last);
+	if (IsTrap(decodeCache[last].opCode))
+	    break;
+	if (IsBranch(decodeCache[last].opCode)) {
+	    last++;
+	    break;
+	}
+    }
+    if (!decodeValid[last])
+	DecodeWord(last);
+
+    block = new BasicBlock(last - first + 1);
+    for (i = 0; i < block->numOps; i++) {
+	block->ops[i].instr = decodeCache[first + i];
+	block->ops[i].handler = HandlerFor(decodeCache[first + i].opCode);
+    }
+    blockCache[first] = block;
+    return block;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunBlocks
+// 	Simulate the execution of a user-level program, a basic block at
+//	a time.  Called by Machine::Run; never returns.
+//
+//	We stop running a block early if it traps to the kernel, if an
+//	interrupt fires (either could change anything at all), or if it
+//	overwrites its own code.
+//
+//	Like Run, this routine is re-entrant; the one thing we hold
+//	across a trap or interrupt is the block we were running, and we
+//	don't touch that after the kernel has had a chance to run.
+//----------------------------------------------------------------------
+
+void
+Machine::RunBlocks()
+{
+    Instruction *instr = new Instruction;  // for OneInstruction
+    BasicBlock *block;
+    BlockOp *op;
+    bool ok;
+    int i;
+
+    for (;;) {
+	while (!staleBlocks->IsEmpty())		// nobody is running these
+	    delete (BasicBlock *) staleBlocks->Remove();
+
+	block = FindBlock();
+	if (block == NULL) {
+	    OneInstruction(instr);
+	    interrupt->OneTick();
+	    continue;
+	}
+
+	for (i = 0, op = block->ops; i < block->numOps; i++, op++) {
+	    ok = (*op->handler)(this, op);
+
+	    // advance simulated time, as in Interrupt::OneTick
+	    stats->totalTicks += UserTick;
+	    stats->userTicks += UserTick;
+	    if (stats->totalTicks >= interrupt->NextDue()) {
+		interrupt->CheckPending();
+		break;
+	    }
+	    if (!ok || !block->valid)
+		break;
+	}
+    }
+}
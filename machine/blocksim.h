@@ -0,0 +1,52 @@
+// blocksim.h 
+//	Data structures for the basic block interpreter, an alternative 
+//	to simulating user programs one instruction at a time.
+//
+//	A basic block is a straight line run of instructions, all in one
+//	physical page, which ends with a trap (eg, a syscall), with a
+//	branch or jump and its delay slot, or with the end of the page.
+//	The first time we run a block, we turn each of its instructions
+//	into a BlockOp: the decoded instruction, plus a pointer to a 
+//	routine that executes just that kind of instruction.  After that,
+//	running the block is a loop calling through the pointers -- there
+//	is no fetch, no decode, and no big switch.
+//
+//	Blocks are found by the physical address of their first instruction,
+//	and are thrown away whenever that page of memory is changed
+//	(see Machine::InvalidateDecodedPage).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef BLOCKSIM_H
+#define BLOCKSIM_H
+
+#include "copyright.h"
+#include "machine.h"
+
+class BlockOp;
+
+// The routine that executes one kind of instruction.  Like 
+// Machine::ExecuteInstruction, returns FALSE if there was an exception.
+typedef bool (*OpHandler)(Machine *m, BlockOp *op);
+
+class BlockOp {
+  public:
+    OpHandler handler;		// the routine that executes the instruction
+    Instruction instr;		// the instruction, already decoded
+};
+
+class BasicBlock {
+  public:
+    BasicBlock(int length);	// Initialize an empty block of "length"
+				// instructions
+    ~BasicBlock();		// De-allocate the block
+
+    int numOps;			// number of instructions in the block
+    BlockOp *ops;		// the instructions, in order
+    bool valid;			// FALSE once the block's code has been 
+				// overwritten
+};
+
+#endif // BLOCKSIM_H
@@ -56,7 +56,8 @@ Console::Console(char *readFile, char *writeFile, VoidFunctionPtr readAvail,
     incoming = EOF;
 
     // start polling for incoming packets
-    interrupt->Schedule(ConsoleReadPoll, (int)this, ConsoleTime, ConsoleReadInt);
+    interrupt->SchedulePoll(ConsoleReadPoll, (int)this, ConsoleTime, 
+			ConsoleReadInt, readFileNo);
 }
 
 //----------------------------------------------------------------------
@@ -89,8 +90,8 @@ Console::CheckCharAvail()
     char c;
 
     // schedule the next time to poll for a packet
-    interrupt->Schedule(ConsoleReadPoll, (int)this, ConsoleTime, 
-			ConsoleReadInt);
+    interrupt->SchedulePoll(ConsoleReadPoll, (int)this, ConsoleTime, 
+			ConsoleReadInt, readFileNo);
 
     // do nothing if character is already buffered, or none to be read
     if ((incoming != EOF) || !PollFile(readFileNo))
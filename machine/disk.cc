@@ -5,7 +5,8 @@
 //	therefore about the behavior of this simulation).
 //
 //	Disk operations are asynchronous, so we have to invoke an interrupt
-//	handler when the simulated operation completes.
+//	handler when the simulated operation completes.  Several requests
+//	can be outstanding; the disk chooses the order to do them in.
 //
 //  DO NOT CHANGE -- part of the machine emulation
 //
@@ -36,7 +37,7 @@ static void DiskDone(int arg) { ((Disk *)arg)->HandleInterrupt(); }
 //
 //	"name" -- text name of the file simulating the Nachos disk
 //	"callWhenDone" -- interrupt handler to be called when disk read/write
-//	   request completes
+//	   request completes; may be NULL if only QueueRequest is used
 //	"callArg" -- argument to pass the interrupt handler
 //----------------------------------------------------------------------
 
@@ -65,6 +66,8 @@ Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg)
 	WriteFile(fileno, (char *)&tmp, sizeof(int));  
     }
     active = FALSE;
+    current = queue = queueTail = NULL;
+    numQueued = 0;
 }
 
 //----------------------------------------------------------------------
@@ -75,6 +78,13 @@ Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg)
 
 Disk::~Disk()
 {
+    DiskRequest *next;
+
+    delete current;
+    for (; queue != NULL; queue = next) {
+	next = queue->next;
+	delete queue;
+    }
     Close(fileno);
 }
 
@@ -98,71 +108,176 @@ PrintSector (bool writing, int sector, char *data)
 }
 
 //----------------------------------------------------------------------
-// Disk::ReadRequest/WriteRequest
-// 	Simulate a request to read/write a single disk sector
-//	   Do the read/write immediately to the UNIX file
-//	   Set up an interrupt handler to be called later,
-//	      that will notify the caller when the simulator says
-//	      the operation has completed.
+// Disk::QueueRequest
+// 	Queue a request to read/write a run of disk sectors.  If the disk
+//	is idle, it starts on the request at once; otherwise the request 
+//	waits until the disk chooses to do it (see StartNext).
 //
 //	Note that a disk only allows an entire sector to be read/written,
 //	not part of a sector.
 //
 //	"sectorNumber" -- the disk sector to read/write
-//	"data" -- the bytes to be written, the buffer to hold the incoming bytes
+//	"data" -- the bytes to be written, the buffer to hold the incoming 
+//	   bytes; must stay put until the request completes
+//	"writing" -- TRUE for a write
+//	"done", "doneArg" -- call (*done)(doneArg) when the request completes
+//	"count" -- the number of sectors, starting at sectorNumber; they
+//	   must all be on the same track
 //----------------------------------------------------------------------
 
 void
-Disk::ReadRequest(int sectorNumber, char* data)
+Disk::QueueRequest(int sectorNumber, char* data, bool writing,
+		   VoidFunctionPtr done, int doneArg, int count)
 {
-    int ticks = ComputeLatency(sectorNumber, FALSE);
+    DiskRequest *request = new DiskRequest;
 
-    ASSERT(!active);				// only one request at a time
     ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((count >= 1) && (sectorNumber % SectorsPerTrack + count 
+				<= SectorsPerTrack));
+    ASSERT(numQueued < MaxDiskRequests);	// the queue is full
     
-    DEBUG('d', "Reading from sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    Read(fileno, data, SectorSize);
-    if (DebugIsEnabled('d'))
-	PrintSector(FALSE, sectorNumber, data);
-    
-    active = TRUE;
-    UpdateLast(sectorNumber);
-    stats->numDiskReads++;
-    interrupt->Schedule(DiskDone, (int) this, ticks, DiskInt);
+    request->sector = sectorNumber;
+    request->count = count;
+    request->data = data;
+    request->writing = writing;
+    request->done = done;
+    request->doneArg = doneArg;
+    request->passedOver = 0;
+    request->next = NULL;
+    if (queueTail == NULL)
+	queue = request;
+    else
+	queueTail->next = request;
+    queueTail = request;
+    numQueued++;
+    DEBUG('d', "Queued %s of %d sectors at %d, %d requests outstanding\n",
+	  writing ? "write" : "read", count, sectorNumber, numQueued);
+    if (!active)
+	StartNext();
+}
+
+//----------------------------------------------------------------------
+// Disk::ReadRequest/WriteRequest
+// 	Queue a request to read/write a single disk sector, that will 
+//	invoke the interrupt handler passed to the constructor when it 
+//	is done.
+//
+//	"sectorNumber" -- the disk sector to read/write
+//	"data" -- the bytes to be written, the buffer to hold the incoming bytes
+//----------------------------------------------------------------------
+
+void
+Disk::ReadRequest(int sectorNumber, char* data)
+{
+    ASSERT(handler != NULL);
+    QueueRequest(sectorNumber, data, FALSE, handler, handlerArg);
 }
 
 void
 Disk::WriteRequest(int sectorNumber, char* data)
 {
-    int ticks = ComputeLatency(sectorNumber, TRUE);
+    ASSERT(handler != NULL);
+    QueueRequest(sectorNumber, data, TRUE, handler, handlerArg);
+}
+
+//----------------------------------------------------------------------
+// Disk::StartNext
+// 	Start on the queued request that will take the least time, given
+//	where the head is now.  A request is not a candidate if an earlier
+//	request is for any of the same sectors, and one that has been 
+//	passed over too often is taken regardless.
+//
+//	The read/write is done immediately to the UNIX file; an interrupt
+//	is scheduled to tell the caller when the simulator says the
+//	operation has completed.
+//----------------------------------------------------------------------
+
+void
+Disk::StartNext()
+{
+    DiskRequest *r, *prev, *earlier, *best = NULL, *bestPrev = NULL;
+    int i, latency, ticks = 0;
 
     ASSERT(!active);
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
-    
-    DEBUG('d', "Writing to sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
+    for (prev = NULL, r = queue; r != NULL; prev = r, r = r->next) {
+	for (earlier = queue; earlier != r; earlier = earlier->next)
+	    if ((earlier->sector < r->sector + r->count)
+		    && (r->sector < earlier->sector + earlier->count))
+		break;
+	if (earlier != r)
+	    continue;			// must wait for the earlier one
+	latency = ComputeLatency(r->sector, r->writing) 
+			+ (r->count - 1) * RotationTime;
+	if (best == NULL || latency < ticks) {
+	    best = r;
+	    bestPrev = prev;
+	    ticks = latency;
+	}
+	if (r->passedOver >= MaxPassedOver) {
+	    best = r;			// it has waited long enough
+	    bestPrev = prev;
+	    ticks = latency;
+	    break;
+	}
+    }
+    if (best == NULL)
+	return;				// nothing to do
+
+    for (r = queue; r != best; r = r->next)
+	r->passedOver++;		// oldest are first
+    if (bestPrev == NULL)
+	queue = best->next;
+    else
+	bestPrev->next = best->next;
+    if (queueTail == best)
+	queueTail = bestPrev;
+    current = best;
+
+    Lseek(fileno, SectorSize * best->sector + MagicSize, 0);
+    if (best->writing) {
+	DEBUG('d', "Writing %d sectors to %d\n", best->count, best->sector);
+	TRACE(TraceDiskWrite, best->sector, best->count);
+	WriteFile(fileno, best->data, SectorSize * best->count);
+	stats->Count(SectorWriteEvent, best->count);
+    } else {
+	DEBUG('d', "Reading %d sectors from %d\n", best->count, best->sector);
+	TRACE(TraceDiskRead, best->sector, best->count);
+	Read(fileno, best->data, SectorSize * best->count);
+	stats->Count(SectorReadEvent, best->count);
+    }
     if (DebugIsEnabled('d'))
-	PrintSector(TRUE, sectorNumber, data);
+	for (i = 0; i < best->count; i++)
+	    PrintSector(best->writing, best->sector + i, 
+			&best->data[i * SectorSize]);
     
     active = TRUE;
-    UpdateLast(sectorNumber);
-    stats->numDiskWrites++;
+    stats->numDiskRequests++;
+    stats->diskSeekTracks += abs(best->sector / SectorsPerTrack 
+				 - lastSector / SectorsPerTrack);
+    UpdateLast(best->sector + best->count - 1);
     interrupt->Schedule(DiskDone, (int) this, ticks, DiskInt);
 }
 
 //----------------------------------------------------------------------
 // Disk::HandleInterrupt()
 // 	Called when it is time to invoke the disk interrupt handler,
-//	to tell the Nachos kernel that the disk request is done.
+//	to tell the Nachos kernel that the disk request is done.  The
+//	disk then moves on to the next request, including any that the
+//	handler just queued.
 //----------------------------------------------------------------------
 
 void
 Disk::HandleInterrupt ()
 { 
+    DiskRequest *done = current;
+
     active = FALSE;
-    (*handler)(handlerArg);
+    current = NULL;
+    numQueued--;
+    (*done->done)(done->doneArg);
+    delete done;
+    if (!active)
+	StartNext();
 }
 
 //----------------------------------------------------------------------
@@ -1,8 +1,7 @@
 // disk.h 
 //	Data structures to emulate a physical disk.  A physical disk
-//	can accept (one at a time) requests to read/write a disk sector;
-//	when the request is satisfied, the CPU gets an interrupt, and 
-//	the next request can be sent to the disk.
+//	can accept a queue of requests to read/write a disk sector; 
+//	when each request is satisfied, the CPU gets an interrupt.
 //
 //	Disk contents are preserved across machine crashes, but if
 //	a file system operation (eg, create a file) is in progress when the 
@@ -45,6 +44,18 @@
 // disks these days now come with a track buffer.
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
+//
+// Like a modern drive with tagged command queueing, the disk accepts 
+// up to MaxDiskRequests requests at once.  Whenever it finishes one, it
+// starts whichever queued request it can get to soonest, according to
+// ComputeLatency; each request has its own completion routine.  Requests
+// for the same sector are always done in the order they were queued, and
+// a request that has been passed over MaxPassedOver times is done next, 
+// so that none waits forever.
+//
+// A request can also cover several consecutive sectors of one track.
+// Once the head reaches the first of them, the rest pass under it one
+// after another, so each extra sector costs only its transfer time.
 
 #define SectorSize 		128	// number of bytes per disk sector
 #define SectorsPerTrack 	32	// number of sectors per disk track 
@@ -52,20 +63,48 @@
 #define NumSectors 		(SectorsPerTrack * NumTracks)
 					// total # of sectors per disk
 
+#define MaxDiskRequests		32	// queue depth of the disk
+#define MaxPassedOver		8	// how many times a request can be 
+					// passed over for a closer one
+
+// One request queued at the disk.
+class DiskRequest {
+  public:
+    int sector;				// which sector to read or write
+    int count;				// # of consecutive sectors
+    char *data;				// where the data comes from/goes to
+    bool writing;			// is it a write?
+    VoidFunctionPtr done;		// call (*done)(doneArg) when it 
+    int doneArg;			// completes
+    int passedOver;			// times a later request went first
+    DiskRequest *next;			// the next request, in arrival order
+};
+
 class Disk {
   public:
     Disk(char* name, VoidFunctionPtr callWhenDone, int callArg);
     					// Create a simulated disk.  
 					// Invoke (*callWhenDone)(callArg) 
-					// every time a request completes.
+					// every time a ReadRequest or 
+					// WriteRequest completes.
     ~Disk();				// Deallocate the disk.
     
+    void QueueRequest(int sectorNumber, char* data, bool writing,
+		      VoidFunctionPtr done, int doneArg, int count = 1);
+    					// Read/write "count" consecutive
+					// sectors on one track (by default,
+					// one).  Sends a request to the disk
+					// and returns immediately; invokes 
+					// (*done)(doneArg) when the request
+					// completes.
     void ReadRequest(int sectorNumber, char* data);
-    					// Read/write an single disk sector.
-					// These routines send a request to 
-    					// the disk and return immediately.
-    					// Only one request allowed at a time!
+    					// Ditto, but invoke the handler
+					// passed to the constructor.
     void WriteRequest(int sectorNumber, char* data);
+    int NumQueued() { return numQueued; }
+					// # of requests not yet completed
+    int LastSector() { return lastSector; }
+					// where the head is, or is going
 
     void HandleInterrupt();		// Interrupt handler, invoked when
 					// disk request finishes.
@@ -81,6 +120,10 @@ class Disk {
 					// when any disk request finishes
     int handlerArg;			// Argument to interrupt handler 
     bool active;     			// Is a disk operation in progress?
+    DiskRequest *current;		// The request in progress
+    DiskRequest *queue;			// Requests not yet started, in the
+    DiskRequest *queueTail;		// order they were made
+    int numQueued;			// # of requests, including current
     int lastSector;			// The previous disk request 
     int bufferInit;			// When the track buffer started 
 					// being loaded
@@ -88,6 +131,7 @@ class Disk {
     int TimeToSeek(int newSector, int *rotate); // time to get to the new track
     int ModuloDiff(int to, int from);        // # sectors between to and from
     void UpdateLast(int newSector);
+    void StartNext();			// start the best queued request
 };
 
 #endif // DISK_H
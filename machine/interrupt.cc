@@ -28,7 +28,8 @@
 
 static char *intLevelNames[] = { "off", "on"};
 static char *intTypeNames[] = { "timer", "disk", "console write", 
-			"console read", "network send", "network recv"};
+			"console read", "elevator", "network send", 
+			"network recv", "cache flush"};
 
 //----------------------------------------------------------------------
 // PendingInterrupt::PendingInterrupt
@@ -50,17 +51,49 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
     type = kind;
 }
 
+//----------------------------------------------------------------------
+// FileWatch::FileWatch
+// 	Initialize a device that is waiting for input on a host file,
+//	rather than polling for it.
+//
+//	"func" is the device's poll routine, called once input arrives
+//	"param" is the argument to pass to the procedure
+//	"interval" is how often the device would otherwise have polled
+//	"kind" is the hardware device that is waiting
+//	"fileNo" is the host file descriptor to wait on
+//----------------------------------------------------------------------
+
+FileWatch::FileWatch(VoidFunctionPtr func, int param, int interval, 
+				IntType kind, int fileNo)
+{
+    handler = func;
+    arg = param;
+    pollInterval = interval;
+    type = kind;
+    fd = fileNo;
+}
+
 //----------------------------------------------------------------------
 // Interrupt::Interrupt
 // 	Initialize the simulation of hardware device interrupts.
 //	
 //	Interrupts start disabled, with no interrupts pending, etc.
+//
+//	"ff" -- if TRUE, devices that poll for input (the console
+//		and the network) wait on their host files instead, so 
+//		that an idle machine can skip straight to the next real
+//		event, or sleep on the host until input arrives.
 //----------------------------------------------------------------------
 
-Interrupt::Interrupt()
+Interrupt::Interrupt(bool ff)
 {
     level = IntOff;
-    pending = new List();
+    pending = new Heap();
+    nextDue = NeverDue;
+    traceInterrupts = DebugIsEnabled('i');
+    fastForward = ff;
+    numWatches = 0;
+    nextWatch = NeverDue;
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
@@ -74,8 +107,10 @@ Interrupt::Interrupt()
 Interrupt::~Interrupt()
 {
     while (!pending->IsEmpty())
-	delete (PendingInterrupt *)pending->Remove();
+	delete (PendingInterrupt *)pending->Remove(NULL);
     delete pending;
+    for (int i = 0; i < numWatches; i++)
+	delete watches[i];
 }
 
 //----------------------------------------------------------------------
@@ -150,8 +185,6 @@ Interrupt::Enable()
 void
 Interrupt::OneTick()
 {
-    MachineStatus old = status;
-
 // advance simulated time
     if (status == SystemMode) {
         stats->totalTicks += SystemTick;
@@ -162,6 +195,32 @@ Interrupt::OneTick()
     }
     DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
 
+// nothing can be due yet, so skip checking (but leave interrupts on,
+// as CheckPending would)
+    if ((stats->totalTicks < NextDue()) && !traceInterrupts) {
+	level = IntOn;
+	return;
+    }
+    CheckPending();
+}
+
+//----------------------------------------------------------------------
+// Interrupt::CheckPending
+// 	Check if there are any pending interrupts to be called, and if
+//	so, call them.  This is the second half of OneTick; it is also
+//	called directly by the basic block interpreter (blocksim.cc), 
+//	which advances simulated time itself, and only calls us once 
+//	the time reaches NextDue().
+//----------------------------------------------------------------------
+void
+Interrupt::CheckPending()
+{
+    MachineStatus old = status;
+
+// if any devices are waiting for input, see if it has arrived
+    if (stats->totalTicks >= nextWatch)
+	(void) CheckWatches(FALSE);
+
 // check any pending interrupts are now ready to fire
     ChangeLevel(IntOn, IntOff);		// first, turn off interrupts
 					// (interrupt handlers run with
@@ -206,20 +265,33 @@ Interrupt::YieldOnReturn()
 //
 //	If there are no pending interrupts, stop.  There's nothing
 //	more for us to do.
+//
+//	In fast-forward mode, polling devices don't have interrupts 
+//	pending; they are waiting on their host files.  So we check those
+//	first, and if there is nothing at all to do in simulated time, 
+//	we wait on the host until one of them has input.
 //----------------------------------------------------------------------
 void
 Interrupt::Idle()
 {
     DEBUG('i', "Machine idling; checking for interrupts.\n");
     status = IdleMode;
-    if (CheckIfDue(TRUE)) {		// check for any pending interrupts
-    	while (CheckIfDue(FALSE))	// check for any other pending 
-	    ;				// interrupts
-        yieldOnReturn = FALSE;		// since there's nothing in the
+    if (numWatches > 0)
+	(void) CheckWatches(FALSE);
+    for (;;) {
+	if (CheckIfDue(TRUE)) {		// check for any pending interrupts
+	    while (CheckIfDue(FALSE))	// check for any other pending 
+		;			// interrupts
+	    yieldOnReturn = FALSE;	// since there's nothing in the
 					// ready queue, the yield is automatic
-        status = SystemMode;
-	return;				// return in case there's now
+	    status = SystemMode;
+	    return;			// return in case there's now
 					// a runnable thread
+	}
+	if (numWatches == 0)
+	    break;
+	DEBUG('i', "Machine idle.  Waiting for input.\n");
+	(void) CheckWatches(TRUE);
     }
 
     // if there are no pending interrupts, and nothing is on the ready
@@ -242,6 +314,7 @@ Interrupt::Halt()
 {
     printf("Machine halting!\n\n");
     stats->Print();
+    stats->PrintCounters();
     Cleanup();     // Never returns.
 }
 
@@ -250,7 +323,7 @@ Interrupt::Halt()
 // 	Arrange for the CPU to be interrupted when simulated time
 //	reaches "now + when".
 //
-//	Implementation: just put it on a sorted list.
+//	Implementation: just put it in a heap, sorted by time.
 //
 //	NOTE: the Nachos kernel should not call this routine directly.
 //	Instead, it is only called by the hardware device simulators.
@@ -271,7 +344,86 @@ Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
 					intTypeNames[type], when);
     ASSERT(fromNow > 0);
 
-    pending->SortedInsert(toOccur, when);
+    pending->Insert(toOccur, when);
+    if (when < nextDue)
+	nextDue = when;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::SchedulePoll
+// 	Arrange for a device's poll routine to be called, to check host
+//	file "fd" for input, "fromNow" ticks from now.
+//
+//	Normally this is just Schedule.  But in fast-forward mode, we
+//	only look at the file (all the waiting devices' files at once)
+//	every "fromNow" ticks while the machine is busy, and only schedule
+//	the poll routine once there is something for it to read.  So an
+//	idle device costs nothing, and an idle machine can skip straight
+//	to the next real event.
+//
+//	"handler" is the device's poll routine
+//	"arg" is the argument to pass to the procedure
+//	"fromNow" is how often the device polls
+//	"type" is the hardware device that is polling
+//	"fd" is the host file to check for input
+//----------------------------------------------------------------------
+void
+Interrupt::SchedulePoll(VoidFunctionPtr handler, int arg, int fromNow, 
+				IntType type, int fd)
+{
+    if (!fastForward) {
+	Schedule(handler, arg, fromNow, type);
+	return;
+    }
+    DEBUG('i', "Waiting for input for the %s on file %d\n", 
+					intTypeNames[type], fd);
+    ASSERT(numWatches < MaxFileWatches);
+    watches[numWatches++] = new FileWatch(handler, arg, fromNow, type, fd);
+    if (stats->totalTicks + fromNow < nextWatch)
+	nextWatch = stats->totalTicks + fromNow;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::CheckWatches
+// 	Check if input has arrived for any device waiting on a host file,
+//	and if so, schedule the device's poll routine for the next tick.
+//	If not, arrange to check again when the device would next have 
+//	polled.
+//
+// Returns:
+//	TRUE, if any device had input
+// Params:
+//	"block" -- if TRUE, wait on the host until some device has input
+//----------------------------------------------------------------------
+bool
+Interrupt::CheckWatches(bool block)
+{
+    int fds[MaxFileWatches];
+    bool ready[MaxFileWatches];
+    bool anyReady;
+    int i;
+
+    for (i = 0; i < numWatches; i++)
+	fds[i] = watches[i]->fd;
+    anyReady = PollFiles(numWatches, fds, ready, block);
+
+    nextWatch = NeverDue;
+    for (i = 0; i < numWatches; ) {
+	FileWatch *watch = watches[i];
+
+	if (ready[i]) {			// stop waiting; let it poll
+	    Schedule(watch->handler, watch->arg, 1, watch->type);
+	    delete watch;
+	    numWatches--;
+	    watches[i] = watches[numWatches];
+	    ready[i] = ready[numWatches];
+	} else {
+	    if (stats->totalTicks + watch->pollInterval < nextWatch)
+		nextWatch = stats->totalTicks + watch->pollInterval;
+	    i++;
+	}
+    }
+    return anyReady;
 }
 
 //----------------------------------------------------------------------
@@ -297,29 +449,35 @@ Interrupt::CheckIfDue(bool advanceClock)
 					// to invoke an interrupt handler
     if (DebugIsEnabled('i'))
 	DumpState();
-    PendingInterrupt *toOccur = 
-		(PendingInterrupt *)pending->SortedRemove(&when);
+    PendingInterrupt *toOccur = (PendingInterrupt *)pending->Peek(&when);
 
-    if (toOccur == NULL)		// no pending interrupts
+    if (toOccur == NULL) {		// no pending interrupts
+	nextDue = NeverDue;
 	return FALSE;			
+    }
 
     if (advanceClock && when > stats->totalTicks) {	// advance the clock
 	stats->idleTicks += (when - stats->totalTicks);
 	stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {	// not time yet, put it back
-	pending->SortedInsert(toOccur, when);
+    } else if (when > stats->totalTicks) {	// not time yet, leave it
+	nextDue = when;
 	return FALSE;
     }
 
 // Check if there is nothing more to do, and if so, quit
     if ((status == IdleMode) && (toOccur->type == TimerInt) 
-				&& pending->IsEmpty()) {
-	 pending->SortedInsert(toOccur, when);
+				&& (pending->NumInHeap() == 1)) {
+	 nextDue = when;
 	 return FALSE;
     }
 
+    (void) pending->Remove(&when);
+    if (pending->Peek(&nextDue) == NULL)
+	nextDue = NeverDue;
+
     DEBUG('i', "Invoking interrupt handler for the %s at time %d\n", 
 			intTypeNames[toOccur->type], toOccur->when);
+    TRACE(TraceInterrupt, toOccur->type, 0);
 #ifdef USER_PROGRAM
     if (machine != NULL)
     	machine->DelayedLoad(0, 0);
@@ -329,6 +487,11 @@ Interrupt::CheckIfDue(bool advanceClock)
 						// we are now going to be
 						// running in the kernel
     (*(toOccur->handler))(toOccur->arg);	// call the interrupt handler
+#ifdef USER_PROGRAM
+    if (machine != NULL)
+	machine->FlushTranslationCache();	// the handler may have changed
+						// the page table or TLB
+#endif
     status = old;				// restore the machine status
     inHandler = FALSE;
     delete toOccur;
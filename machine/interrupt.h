@@ -36,7 +36,7 @@
 #define INTERRUPT_H
 
 #include "copyright.h"
-#include "list.h"
+#include "heap.h"
 
 // Interrupts can be disabled (IntOff) or enabled (IntOn)
 enum IntStatus { IntOff, IntOn };
@@ -46,11 +46,16 @@ enum IntStatus { IntOff, IntOn };
 // is empty (IdleMode).
 enum MachineStatus {IdleMode, SystemMode, UserMode};
 
+// NeverDue is the value of Interrupt::NextDue() when there are no
+// interrupts pending
+#define NeverDue	0x7fffffff
+
 // IntType records which hardware device generated an interrupt.
 // In Nachos, we support a hardware timer device, a disk, a console
 // display and keyboard, and a network.
 enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt, 
-				ElevatorInt, NetworkSendInt, NetworkRecvInt};
+				ElevatorInt, NetworkSendInt, NetworkRecvInt,
+				CacheFlushInt};
 
 // The following class defines an interrupt that is scheduled
 // to occur in the future.  The internal data structures are
@@ -69,6 +74,24 @@ class PendingInterrupt {
     IntType type;		// for debugging
 };
 
+// The following class defines a device waiting for input to arrive on 
+// a host (UNIX) file, in fast-forward mode; see Interrupt::SchedulePoll.
+
+#define MaxFileWatches	8	// most devices that can wait at once
+
+class FileWatch {
+  public:
+    FileWatch(VoidFunctionPtr func, int param, int interval, IntType kind,
+				int fileNo);
+				// initialize a device waiting for input
+
+    VoidFunctionPtr handler;    // The device's poll routine
+    int arg;                    // The argument to the function.
+    int pollInterval;		// How often the device would have polled
+    IntType type;		// What kind of interrupt it would have been
+    int fd;			// The host file we are waiting on
+};
+
 // The following class defines the data structures for the simulation
 // of hardware interrupts.  We record whether interrupts are enabled
 // or disabled, and any hardware interrupts that are scheduled to occur
@@ -76,7 +99,7 @@ class PendingInterrupt {
 
 class Interrupt {
   public:
-    Interrupt();			// initialize the interrupt simulation
+    Interrupt(bool fastForward);	// initialize the interrupt simulation
     ~Interrupt();			// de-allocate data structures
     
     IntStatus SetLevel(IntStatus level);// Disable or enable interrupts 
@@ -109,13 +132,34 @@ class Interrupt {
     void Schedule(VoidFunctionPtr handler,// Schedule an interrupt to occur
 	int arg, int when, IntType type);// at time ``when''.  This is called
     					// by the hardware device simulators.
+
+    void SchedulePoll(VoidFunctionPtr handler, int arg, int when, 
+	IntType type, int fd);		// Schedule a device's next poll
+					// of host file "fd" for input.
     
     void OneTick();       		// Advance simulated time
+    void CheckPending();		// Fire any interrupts that are due 
+					// now, without advancing the time
+    int NextDue() { return (nextDue < nextWatch) ? nextDue : nextWatch; }
+					// No interrupt is due before 
+					// this time (NeverDue if none is
+					// pending)
 
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    List *pending;		// the list of interrupts scheduled
-				// to occur in the future
+    Heap *pending;		// the interrupts scheduled to occur in
+				// the future, soonest first
+    int nextDue;		// when the first pending interrupt is due;
+				// until then, OneTick needn't look at
+				// "pending" at all
+    bool traceInterrupts;	// are we printing interrupt state on
+				// every tick?  (if so, we can't skip it)
+
+    bool fastForward;		// do polling devices wait on their host
+				// files, rather than scheduling polls?
+    FileWatch *watches[MaxFileWatches]; // the devices waiting for input
+    int numWatches;		// number of entries in "watches"
+    int nextWatch;		// when to look at their files again
     bool inHandler;		// TRUE if we are running an interrupt handler
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
@@ -126,6 +170,9 @@ class Interrupt {
     bool CheckIfDue(bool advanceClock); // Check if an interrupt is supposed
 					// to occur now
 
+    bool CheckWatches(bool block);	// Check if input has arrived for any
+					// waiting device
+
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 	IntStatus now);  		// simulated time
 };
@@ -9,6 +9,7 @@
 
 #include "copyright.h"
 #include "machine.h"
+#include "blocksim.h"
 #include "system.h"
 
 // Textual names of the exceptions that can be generated by user program
@@ -50,9 +51,11 @@ void CheckEndian()
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"blocks" -- if TRUE, run user code with the basic block interpreter
+//		(see blocksim.cc).
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, bool blocks)
 {
     int i;
 
@@ -61,6 +64,16 @@ Machine::Machine(bool debug)
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
+    decodeCache = new Instruction[MemorySize / 4];
+    decodeValid = new bool[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++)
+	decodeValid[i] = FALSE;
+    for (i = 0; i < NumPhysPages; i++)
+	pageDecoded[i] = FALSE;
+    blockCache = new BasicBlock *[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++)
+	blockCache[i] = NULL;
+    staleBlocks = new List;
 #ifdef USE_TLB
     tlb = new TranslationEntry[TLBSize];
     for (i = 0; i < TLBSize; i++)
@@ -72,6 +85,9 @@ Machine::Machine(bool debug)
 #endif
 
     singleStep = debug;
+    blockMode = blocks;
+    traceTranslate = DebugIsEnabled('a');
+    FlushTranslationCache();
     CheckEndian();
 }
 
@@ -83,6 +99,14 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete [] mainMemory;
+    delete [] decodeCache;
+    delete [] decodeValid;
+    for (int i = 0; i < MemorySize / 4; i++)
+	delete blockCache[i];
+    delete [] blockCache;
+    while (!staleBlocks->IsEmpty())
+	delete (BasicBlock *) staleBlocks->Remove();
+    delete staleBlocks;
     if (tlb != NULL)
         delete [] tlb;
 }
@@ -101,12 +125,20 @@ void
 Machine::RaiseException(ExceptionType which, int badVAddr)
 {
     DEBUG('m', "Exception: %s\n", exceptionNames[which]);
+    if (which == PageFaultException)
+	stats->Count(tlb != NULL ? TLBMissEvent : PageFaultEvent);
+    if (which == SyscallException)
+	TRACE(TraceSyscall, registers[2], 0);
+    else
+	TRACE(TraceException, which, badVAddr);
     
 //  ASSERT(interrupt->getStatus() == UserMode);
     registers[BadVAddrReg] = badVAddr;
     DelayedLoad(0, 0);			// finish anything in progress
     interrupt->setStatus(SystemMode);
     ExceptionHandler(which);		// interrupts are enabled at this point
+    FlushTranslationCache();		// the kernel may have changed the
+					// page table or TLB
     interrupt->setStatus(UserMode);
 }
 
@@ -24,6 +24,7 @@
 #include "copyright.h"
 #include "utility.h"
 #include "translate.h"
+#include "list.h"
 #include "disk.h"
 
 // Definitions related to the size, and format of user memory
@@ -35,6 +36,7 @@
 #define NumPhysPages    32
 #define MemorySize 	(NumPhysPages * PageSize)
 #define TLBSize		4		// if there is a TLB, make it small
+#define InstrsPerPage	(PageSize / 4)	// instruction words in one page
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -104,9 +106,12 @@ class Instruction {
 // The procedures in this class are defined in machine.cc, mipssim.cc, and
 // translate.cc.
 
+class BasicBlock;
+
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
+    Machine(bool debug, bool blocks);
+				// Initialize the simulation of the hardware
 				// for running user programs
     ~Machine();			// De-allocate the data structures
 
@@ -118,11 +123,49 @@ class Machine {
     void WriteRegister(int num, int value);
 				// store a value into a CPU register
 
+    void InvalidateDecodedPage(int physPage);
+				// Forget any decoded instructions from 
+				// physical page "physPage".  The kernel
+				// must call this after it changes the
+				// contents of a page directly (rather
+				// than through WriteMem), eg, when it
+				// loads code into memory.
+
+    bool CopyFromUser(int virtAddr, char *buffer, int size);
+    bool CopyToUser(int virtAddr, char *buffer, int size);
+				// Copy "size" bytes between user virtual 
+				// memory and a kernel buffer.  Return FALSE
+				// (after raising the exception) if some
+				// page couldn't be translated.
+    int CopyStringFromUser(int virtAddr, char *buffer, int maxLength);
+				// Copy a null-terminated string from user
+				// virtual memory; return its length, or
+				// -1 if some page couldn't be translated
+
+    void FlushTranslationCache();
+				// Forget all recent address translations.
+				// Done automatically whenever we return to
+				// user code from the kernel; the kernel
+				// must call this itself if it changes the
+				// page table or TLB and then reads or
+				// writes user memory before returning.
+
 
 // Routines internal to the machine simulation -- DO NOT call these 
 
     void OneInstruction(Instruction *instr); 	
     				// Run one instruction of a user program.
+    bool FetchInstruction(Instruction *instr);
+				// Fetch and decode the instruction at PC,
+				// using the decoded-instruction cache.
+				// Return FALSE if the fetch failed.
+    bool ExecuteInstruction(Instruction *instr);
+				// Execute an already decoded instruction.
+				// Return FALSE if it caused an exception.
+    void RunBlocks();		// Run(), a basic block at a time, rather
+				// than an instruction at a time
+    BasicBlock *FindBlock();	// Find (or build) the basic block that 
+				// starts at PC, if we can run one there
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
     
@@ -187,6 +230,27 @@ class Machine {
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
 				// time reaches this value
+
+    Instruction *decodeCache;	// already-decoded copy of each word of
+				// main memory, indexed by physical address/4
+    bool *decodeValid;		// is the decodeCache entry up to date?
+    bool pageDecoded[NumPhysPages]; // does the page have any valid
+				// decodeCache entries?  (so that a store
+				// to a data page need not invalidate it)
+
+    bool blockMode;		// run user code a basic block at a time?
+    BasicBlock **blockCache;	// the basic block starting at each word of
+				// main memory, if we've built one
+    List *staleBlocks;		// blocks whose code was overwritten, but
+				// which might still be running; they are
+				// deleted before we start the next block
+    void DecodeWord(int word);	// Fill in decodeCache[word]
+
+    CachedTranslation translationCache[2][TranslationCacheSize];
+				// recent successful translations, indexed
+				// by [writing][virtual page # modulo size]
+    bool traceTranslate;	// are we printing each translation?  If
+				// so, Translate can't take any short cuts
 };
 
 extern void ExceptionHandler(ExceptionType which);
@@ -14,6 +14,7 @@
 
 #include "machine.h"
 #include "mipssim.h"
+#include "blocksim.h"
 #include "system.h"
 
 static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
@@ -36,9 +37,21 @@ Machine::Run()
         printf("Starting thread \"%s\" at time %d\n",
 	       currentThread->getName(), stats->totalTicks);
     interrupt->setStatus(UserMode);
+
+    // the basic block interpreter doesn't print instruction or interrupt
+    // traces, can't single step, and doesn't tell the profiler about calls
+    if (blockMode && !singleStep && profiler == NULL 
+		&& !DebugIsEnabled('m') && !DebugIsEnabled('i') 
+		&& !DebugIsEnabled('a'))
+	RunBlocks();		// never returns
+
     for (;;) {
         OneInstruction(instr);
 	interrupt->OneTick();
+	if (profiler != NULL && stats->userTicks >= profiler->nextSample) {
+	    profiler->Sample(registers[PCReg]);
+	    profiler->nextSample += profiler->interval;
+	}
 	if (singleStep && (runUntilTime <= stats->totalTicks))
 	  Debugger();
     }
@@ -87,22 +100,17 @@ TypeToReg(RegType reg, Instruction *instr)
 //	store all data back to the machine registers and memory before
 //	leaving.  This allows the Nachos kernel to control our behavior
 //	by controlling the contents of memory, the translation table,
-//	and the register set.
+//	and the register set.  (The one exception is the decoded-instruction
+//	cache, which is indexed by physical address and so only depends
+//	on the contents of memory; see FetchInstruction.)
 //----------------------------------------------------------------------
 
 void
 Machine::OneInstruction(Instruction *instr)
 {
-    int raw;
-    int nextLoadReg = 0; 	
-    int nextLoadValue = 0; 	// record delayed load operation, to apply
-				// in the future
-
     // Fetch instruction 
-    if (!machine->ReadMem(registers[PCReg], 4, &raw))
+    if (!FetchInstruction(instr))
 	return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
 
     if (DebugIsEnabled('m')) {
        struct OpString *str = &opStrings[instr->opCode];
@@ -113,7 +121,30 @@ Machine::OneInstruction(Instruction *instr)
 		TypeToReg(str->args[1], instr), TypeToReg(str->args[2], instr));
        printf("\n");
        }
-    
+
+    (void) ExecuteInstruction(instr);
+}
+
+//----------------------------------------------------------------------
+// Machine::ExecuteInstruction
+// 	Execute one already-fetched and decoded instruction, at the 
+//	current PC.  Split out from OneInstruction so that the basic
+//	block interpreter (blocksim.cc) can use it for the instructions
+//	it doesn't have its own handler for.
+//
+//	Returns FALSE if there was an exception (which has been raised
+//	already), in which case the PC has not been advanced.
+//
+//	"instr" -- the decoded instruction
+//----------------------------------------------------------------------
+
+bool
+Machine::ExecuteInstruction(Instruction *instr)
+{
+    int nextLoadReg = 0; 	
+    int nextLoadValue = 0; 	// record delayed load operation, to apply
+				// in the future
+
     // Compute next pc, but don't install in case there's an error or branch.
     int pcAfter = registers[NextPCReg] + 4;
     int sum, diff, tmp, value;
@@ -127,7 +158,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = sum;
 	break;
@@ -137,7 +168,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
 	    ((instr->extra ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rt] = sum;
 	break;
@@ -218,13 +249,22 @@ Machine::OneInstruction(Instruction *instr)
 	
       case OP_JAL:
 	registers[R31] = registers[NextPCReg] + 4;
+	if (profiler != NULL)
+	    profiler->Call(registers[PCReg]);
       case OP_J:
 	pcAfter = (pcAfter & 0xf0000000) | IndexToAddr(instr->extra);
 	break;
 	
       case OP_JALR:
 	registers[instr->rd] = registers[NextPCReg] + 4;
+	if (profiler != NULL)
+	    profiler->Call(registers[PCReg]);
+	pcAfter = registers[instr->rs];
+	break;
+
       case OP_JR:
+	if (profiler != NULL && instr->rs == R31)
+	    profiler->Return();
 	pcAfter = registers[instr->rs];
 	break;
 	
@@ -232,7 +272,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_LBU:
 	tmp = registers[instr->rs] + instr->extra;
 	if (!machine->ReadMem(tmp, 1, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x80) && (instr->opCode == OP_LB))
 	    value |= 0xffffff00;
@@ -247,10 +287,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x1) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!machine->ReadMem(tmp, 2, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x8000) && (instr->opCode == OP_LH))
 	    value |= 0xffff0000;
@@ -269,10 +309,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x3) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	nextLoadReg = instr->rt;
 	nextLoadValue = value;
 	break;
@@ -286,7 +326,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	if (registers[LoadReg] == instr->rt)
 	    nextLoadValue = registers[LoadValueReg];
 	else
@@ -317,7 +357,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	if (registers[LoadReg] == instr->rt)
 	    nextLoadValue = registers[LoadValueReg];
 	else
@@ -383,13 +423,13 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SB:
 	if (!machine->WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SH:
 	if (!machine->WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SLL:
@@ -459,7 +499,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = diff;
 	break;
@@ -471,7 +511,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SW:
 	if (!machine->WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SWL:	  
@@ -482,7 +522,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	    return FALSE;
 	switch (tmp & 0x3) {
 	  case 0:
 	    value = registers[instr->rt];
@@ -501,7 +541,7 @@ Machine::OneInstruction(Instruction *instr)
 	    break;
 	}
 	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
+	    return FALSE;
 	break;
     	
       case OP_SWR:	  
@@ -512,7 +552,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	    return FALSE;
 	switch (tmp & 0x3) {
 	  case 0:
 	    value = (value & 0xffffff) | (registers[instr->rt] << 24);
@@ -528,12 +568,12 @@ Machine::OneInstruction(Instruction *instr)
 	    break;
 	}
 	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
+	    return FALSE;
 	break;
     	
       case OP_SYSCALL:
 	RaiseException(SyscallException, 0);
-	return; 
+	return FALSE; 
 	
       case OP_XOR:
 	registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
@@ -546,7 +586,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_RES:
       case OP_UNIMP:
 	RaiseException(IllegalInstrException, 0);
-	return;
+	return FALSE;
 	
       default:
 	ASSERT(FALSE);
@@ -562,6 +602,91 @@ Machine::OneInstruction(Instruction *instr)
 						// are jumping into lala-land
     registers[PCReg] = registers[NextPCReg];
     registers[NextPCReg] = pcAfter;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::FetchInstruction
+// 	Fetch the instruction at the current PC into "instr", decoded.
+//
+//	We always translate the PC, so that the use bit and any exception
+//	are exactly what ReadMem would have given us.  But the decoding
+//	is looked up in a cache indexed by physical address, so that
+//	loops don't re-decode the same words over and over again.  
+//	WriteMem and InvalidateDecodedPage keep the cache up to date.
+//
+//	Returns FALSE if the translation failed (and so an exception
+//	has been raised).
+//
+//	"instr" -- storage for the decoded instruction
+//----------------------------------------------------------------------
+
+bool
+Machine::FetchInstruction(Instruction *instr)
+{
+    int physicalAddress, word;
+    ExceptionType exception;
+
+    DEBUG('a', "Reading VA 0x%x, size 4\n", registers[PCReg]);
+
+    exception = Translate(registers[PCReg], &physicalAddress, 4, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, registers[PCReg]);
+	return FALSE;
+    }
+    word = physicalAddress / 4;
+    if (!decodeValid[word])
+	DecodeWord(word);
+    *instr = decodeCache[word];
+
+    DEBUG('a', "\tvalue read = %8.8x\n", instr->value);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::DecodeWord
+// 	Decode the word of main memory at physical address 4*"word", 
+//	and remember the result in the decoded-instruction cache.
+//----------------------------------------------------------------------
+
+void
+Machine::DecodeWord(int word)
+{
+    decodeCache[word].value = 
+		WordToHost(*(unsigned int *) &mainMemory[word * 4]);
+    decodeCache[word].Decode();
+    decodeValid[word] = TRUE;
+    pageDecoded[word / InstrsPerPage] = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateDecodedPage
+// 	Throw away the cached decodings of every instruction word in a
+//	physical page, because the page's contents have changed, along
+//	with any basic blocks built from them.
+//
+//	The block we are in the middle of running might be one of them, 
+//	so we just mark the blocks invalid here; they are deleted by 
+//	RunBlocks once it is done with them.
+//
+//	"physPage" -- the physical page number
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateDecodedPage(int physPage)
+{
+    int first = physPage * InstrsPerPage;
+
+    ASSERT((physPage >= 0) && (physPage < NumPhysPages));
+    for (int i = first; i < first + InstrsPerPage; i++) {
+	decodeValid[i] = FALSE;
+	if (blockCache[i] != NULL) {
+	    blockCache[i]->valid = FALSE;
+	    staleBlocks->Append((void *)blockCache[i]);
+	    blockCache[i] = NULL;
+	}
+    }
+    pageDecoded[physPage] = FALSE;
 }
 
 //----------------------------------------------------------------------
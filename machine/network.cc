@@ -45,7 +45,8 @@ Network::Network(NetworkAddress addr, double reliability,
 						 // in the current directory.
 
     // start polling for incoming packets
-    interrupt->Schedule(NetworkReadPoll, (int)this, NetworkTime, NetworkRecvInt);
+    interrupt->SchedulePoll(NetworkReadPoll, (int)this, NetworkTime, 
+			NetworkRecvInt, sock);
 }
 
 Network::~Network()
@@ -61,7 +62,8 @@ void
 Network::CheckPktAvail()
 {
     // schedule the next time to poll for a packet
-    interrupt->Schedule(NetworkReadPoll, (int)this, NetworkTime, NetworkRecvInt);
+    interrupt->SchedulePoll(NetworkReadPoll, (int)this, NetworkTime, 
+			NetworkRecvInt, sock);
 
     if (inHdr.length != 0) 	// do nothing if packet is already buffered
 	return;		
@@ -0,0 +1,283 @@
+// profile.cc
+//	Routines for the sampling profiler of user programs.  See
+//	profile.h for an overview.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "profile.h"
+#include "system.h"
+
+#define MaxSymbolLength	64	// longest procedure name we read
+
+//----------------------------------------------------------------------
+// Profiler::Profiler
+// 	Initialize the profiler.  Until some symbols are loaded, every
+//	sample is charged to an unknown procedure.
+//
+//	"sampleInterval" is the number of user ticks between samples.
+//----------------------------------------------------------------------
+
+Profiler::Profiler(int sampleInterval)
+{
+    ASSERT(sampleInterval > 0);
+    interval = sampleInterval;
+    nextSample = interval;
+    programName = NULL;
+    numSymbols = 0;
+    symbols = new ProfileSymbol[1];
+    symbols[0].address = 0;
+    symbols[0].name = NULL;
+    symbols[0].self = symbols[0].total = 0;
+    symbols[0].lastSample = -1;
+    numSamples = 0;
+    callDepth = 0;
+    for (int i = 0; i < FoldedBuckets; i++)
+	folded[i] = NULL;
+}
+
+//----------------------------------------------------------------------
+// Profiler::~Profiler
+// 	De-allocate the profiler.
+//----------------------------------------------------------------------
+
+Profiler::~Profiler()
+{
+    FoldedStack *f, *next;
+    int i;
+
+    for (i = 0; i < numSymbols; i++)
+	delete [] symbols[i].name;
+    delete [] symbols;
+    delete [] programName;
+    for (i = 0; i < FoldedBuckets; i++)
+	for (f = folded[i]; f != NULL; f = next) {
+	    next = f->next;
+	    delete [] f->stack;
+	    delete f;
+	}
+}
+
+//----------------------------------------------------------------------
+// Profiler::LoadSymbols
+// 	Read the procedure addresses of a user program, as written by
+//	coff2noff, and sort them by address.  If there is no symbol
+//	file, PCs are printed in hex instead.
+//
+//	Called when the program is loaded, so we also forget any calls
+//	left over from a previous program.
+//
+//	"program" -- the name of the Nachos executable
+//----------------------------------------------------------------------
+
+void
+Profiler::LoadSymbols(char *program)
+{
+    char *symFileName = new char[strlen(program) + 5];
+    char name[MaxSymbolLength];
+    ProfileSymbol tmp;
+    FILE *fp;
+    int address, i, j, count;
+
+    callDepth = 0;
+    delete [] programName;
+    programName = new char[strlen(program) + 1];
+    strcpy(programName, program);
+
+    sprintf(symFileName, "%s.sym", program);
+    fp = fopen(symFileName, "r");
+    delete [] symFileName;
+    if (fp == NULL) {
+	DEBUG('a', "No symbols for \"%s\"\n", program);
+	return;
+    }
+    count = 0;
+    while (fscanf(fp, "%x %63s", &address, name) == 2)
+	count++;
+
+    // throw away the symbols of any earlier program, and its samples
+    // with them
+    for (i = 0; i < numSymbols; i++)
+	delete [] symbols[i].name;
+    delete [] symbols;
+    symbols = new ProfileSymbol[count + 1];
+    rewind(fp);
+    for (numSymbols = 0; numSymbols < count
+		&& fscanf(fp, "%x %63s", &address, name) == 2; numSymbols++) {
+	tmp.address = address;
+	tmp.name = new char[strlen(name) + 1];
+	strcpy(tmp.name, name);
+	tmp.self = tmp.total = 0;
+	tmp.lastSample = -1;
+	for (j = numSymbols; j > 0 && symbols[j - 1].address > address; j--)
+	    symbols[j] = symbols[j - 1];	// insertion sort, by address
+	symbols[j] = tmp;
+    }
+    fclose(fp);
+    symbols[numSymbols].address = 0;		// the unknown procedure
+    symbols[numSymbols].name = NULL;
+    symbols[numSymbols].self = symbols[numSymbols].total = 0;
+    symbols[numSymbols].lastSample = -1;
+    DEBUG('a', "Loaded %d symbols for \"%s\"\n", numSymbols, program);
+}
+
+//----------------------------------------------------------------------
+// Profiler::Lookup
+// 	Find the procedure containing "pc": the one with the highest
+//	starting address at or below it.
+//----------------------------------------------------------------------
+
+int
+Profiler::Lookup(int pc)
+{
+    int low = 0, high = numSymbols - 1, mid;
+
+    if (numSymbols == 0 || pc < symbols[0].address)
+	return numSymbols;
+    while (low < high) {			// binary search
+	mid = (low + high + 1) / 2;
+	if (symbols[mid].address <= pc)
+	    low = mid;
+	else
+	    high = mid - 1;
+    }
+    return low;
+}
+
+//----------------------------------------------------------------------
+// Profiler::Call
+// Profiler::Return
+// 	Keep track of the user program's calls, as it makes them.
+//
+//	"callSite" -- the PC of the jal or jalr
+//----------------------------------------------------------------------
+
+void
+Profiler::Call(int callSite)
+{
+    if (callDepth < MaxCallDepth)
+	callStack[callDepth] = callSite;
+    callDepth++;
+}
+
+void
+Profiler::Return()
+{
+    if (callDepth > 0)		// we may have started in the middle
+	callDepth--;
+}
+
+//----------------------------------------------------------------------
+// Profiler::Sample
+// 	Charge a sample to the procedure containing "pc", and to every
+//	procedure with a call active.
+//
+//	"pc" -- the user program counter at the time of the sample
+//----------------------------------------------------------------------
+
+void
+Profiler::Sample(int pc)
+{
+    char stack[MaxFoldedLength], frame[MaxSymbolLength + 4];
+    int depth = (callDepth < MaxCallDepth) ? callDepth : MaxCallDepth;
+    int i, s, length = 0;
+
+    stack[0] = '\0';
+    for (i = 0; i <= depth; i++) {
+	s = Lookup((i < depth) ? callStack[i] : pc);
+	if (symbols[s].lastSample != numSamples) {
+	    symbols[s].lastSample = numSamples;
+	    symbols[s].total++;
+	}
+	if (s < numSymbols)
+	    sprintf(frame, "%s%s", (i > 0) ? ";" : "", symbols[s].name);
+	else
+	    sprintf(frame, "%s0x%x", (i > 0) ? ";" : "",
+			(i < depth) ? callStack[i] : pc);
+	if (length + (int) strlen(frame) < MaxFoldedLength) {
+	    strcpy(stack + length, frame);
+	    length += strlen(frame);
+	}
+	if (i == depth)
+	    symbols[s].self++;
+    }
+    CountStack(stack);
+    numSamples++;
+}
+
+//----------------------------------------------------------------------
+// Profiler::CountStack
+// 	Add one to the count of samples taken in a call stack, adding
+//	the stack if we haven't seen it before.
+//----------------------------------------------------------------------
+
+void
+Profiler::CountStack(char *stack)
+{
+    unsigned hash = 0;
+    FoldedStack *f;
+    char *p;
+
+    for (p = stack; *p != '\0'; p++)
+	hash = hash * 31 + *p;
+    for (f = folded[hash % FoldedBuckets]; f != NULL; f = f->next)
+	if (!strcmp(f->stack, stack)) {
+	    f->count++;
+	    return;
+	}
+    f = new FoldedStack;
+    f->stack = new char[strlen(stack) + 1];
+    strcpy(f->stack, stack);
+    f->count = 1;
+    f->next = folded[hash % FoldedBuckets];
+    folded[hash % FoldedBuckets] = f;
+}
+
+//----------------------------------------------------------------------
+// Profiler::Write
+// 	Write the flat profile, most expensive procedure first, and the
+//	folded call stacks.
+//----------------------------------------------------------------------
+
+void
+Profiler::Write()
+{
+    ProfileSymbol **order = new ProfileSymbol *[numSymbols + 1];
+    char *name = (programName != NULL) ? programName : (char *) "nachos";
+    char *fileName = new char[strlen(name) + 8];
+    FoldedStack *f;
+    FILE *fp;
+    int i, j;
+
+    for (i = 0; i <= numSymbols; i++) {
+	for (j = i; j > 0 && order[j - 1]->self < symbols[i].self; j--)
+	    order[j] = order[j - 1];	// insertion sort, by samples
+	order[j] = &symbols[i];
+    }
+    sprintf(fileName, "%s.prof", name);
+    if ((fp = fopen(fileName, "w")) != NULL) {
+	fprintf(fp, "%d samples, one every %d user ticks\n\n", numSamples,
+		interval);
+	fprintf(fp, " %%self     self    total  procedure\n");
+	for (i = 0; i <= numSymbols; i++)
+	    if (order[i]->total > 0)
+		fprintf(fp, "%5.1f %8d %8d  %s\n",
+		    (100.0 * order[i]->self) / numSamples, order[i]->self,
+		    order[i]->total,
+		    (order[i]->name != NULL) ? order[i]->name : "<unknown>");
+	fclose(fp);
+    }
+
+    sprintf(fileName, "%s.folded", name);
+    if ((fp = fopen(fileName, "w")) != NULL) {
+	for (i = 0; i < FoldedBuckets; i++)
+	    for (f = folded[i]; f != NULL; f = f->next)
+		fprintf(fp, "%s %d\n", f->stack, f->count);
+	fclose(fp);
+    }
+    printf("Profile written to %s.prof and %s.folded\n", name, name);
+    delete [] fileName;
+    delete [] order;
+}
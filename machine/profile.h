@@ -0,0 +1,84 @@
+// profile.h
+//	Data structures for a sampling profiler of user programs.
+//
+//	Every "interval" ticks of user time, Machine::Run records the
+//	user PC.  Each PC is charged to the procedure containing it,
+//	using the symbols coff2noff writes alongside the Nachos executable
+//	(in "<program>.sym").  We also keep a shadow call stack, pushed
+//	on each jal/jalr and popped on "jr r31", so that every sample
+//	can be charged to its callers as well.
+//
+//	When Nachos exits, we write a flat profile to "<program>.prof",
+//	and the call stacks to "<program>.folded", one line per distinct
+//	stack in the "caller;callee count" form that flame graph tools
+//	read.
+//
+//	Since the shadow stack belongs to the profiler and not to an
+//	address space, it only makes sense for one user program at a time.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+#define MaxCallDepth	64	// calls nested deeper than this are
+				// counted, but not recorded
+#define FoldedBuckets	127	// hash buckets for distinct call stacks
+#define MaxFoldedLength	1024	// longest call stack we print
+
+// One procedure in the user program.
+class ProfileSymbol {
+  public:
+    int address;		// where the procedure starts
+    char *name;			// what it is called
+    int self;			// samples taken in the procedure itself
+    int total;			// samples taken in it or its callees
+    int lastSample;		// the last sample charged to "total", so
+				// that recursion isn't counted twice
+};
+
+// One distinct call stack, and how many samples were taken in it.
+class FoldedStack {
+  public:
+    char *stack;		// "__start;main;Sort"
+    int count;			// how many samples
+    FoldedStack *next;		// next in the same hash bucket
+};
+
+class Profiler {
+  public:
+    Profiler(int sampleInterval);	// initialize the profiler
+    ~Profiler();			// de-allocate it
+
+    void LoadSymbols(char *program);	// read "<program>.sym", and
+					// start over with a fresh call stack
+    void Call(int callSite);		// a jal or jalr at "callSite"
+    void Return();			// a jr r31
+    void Sample(int pc);		// record a sample at "pc"
+    void Write();			// write out the profile
+
+    int nextSample;			// userTicks at which to sample next
+    int interval;			// user ticks between samples
+
+  private:
+    int Lookup(int pc);			// index of procedure containing pc,
+					// or numSymbols if there isn't one
+    void CountStack(char *stack);	// one more sample in this stack
+
+    char *programName;			// for naming the output files
+    ProfileSymbol *symbols;		// sorted by address; one extra
+    int numSymbols;			// entry at the end for unknown PCs
+    int numSamples;
+
+    int callStack[MaxCallDepth];	// call sites of the active calls
+    int callDepth;			// how many calls are active
+
+    FoldedStack *folded[FoldedBuckets];	// all the stacks seen so far
+};
+
+#endif // PROFILE_H
@@ -10,6 +10,61 @@
 #include "copyright.h"
 #include "utility.h"
 #include "stats.h"
+#include <string.h>
+
+//----------------------------------------------------------------------
+// PerfCounters::PerfCounters
+// 	Initialize a set of per-thread or per-address space counters.
+//
+//	"debugName" is copied, since threads are often named by a buffer
+//	that may go away before we print.
+//----------------------------------------------------------------------
+
+PerfCounters::PerfCounters(char *debugName)
+{
+    name = new char[strlen(debugName) + 1];
+    strcpy(name, debugName);
+    userTicks = systemTicks = instructions = 0;
+    tlbMisses = pageFaults = 0;
+    sectorsRead = sectorsWritten = 0;
+    contextSwitches = 0;
+    for (int i = 0; i < NumSyscallCounters; i++)
+	syscalls[i] = 0;
+    next = NULL;
+}
+
+PerfCounters::~PerfCounters()
+{
+    delete [] name;
+}
+
+//----------------------------------------------------------------------
+// PerfCounters::Print
+// 	Print one set of counters.  Syscalls are only listed by number
+//	if any were made.
+//----------------------------------------------------------------------
+
+void
+PerfCounters::Print()
+{
+    int i;
+
+    printf("%s: ticks system %d, user %d, instructions %d\n", name, 
+	systemTicks, userTicks, instructions);
+    printf("    TLB misses %d, page faults %d, sectors read %d, "
+	"written %d, switches %d\n", tlbMisses, pageFaults, sectorsRead,
+	sectorsWritten, contextSwitches);
+    for (i = 0; i < NumSyscallCounters; i++)
+	if (syscalls[i] != 0)
+	    break;
+    if (i == NumSyscallCounters)
+	return;
+    printf("    syscalls:");
+    for (; i < NumSyscallCounters; i++)
+	if (syscalls[i] != 0)
+	    printf(" %d:%d", i, syscalls[i]);
+    printf("\n");
+}
 
 //----------------------------------------------------------------------
 // Statistics::Statistics
@@ -22,6 +77,164 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numTLBMisses = numContextSwitches = numSyscalls = 0;
+    numDiskRequests = diskSeekTracks = 0;
+    diskRequestTicks = maxDiskRequestTicks = 0;
+    numCacheHits = numCacheMisses = numCacheWritebacks = 0;
+    numPrefetches = numPrefetchHits = 0;
+    numNameHits = numNameMisses = 0;
+    numJournalCommits = numJournalSectors = numJournalCheckpoints = 0;
+    numSegmentsCleaned = numSectorsCleaned = 0;
+    firstCounters = lastCounters = NULL;
+    threadCounters = spaceCounters = NULL;
+    lastUserTicks = lastSystemTicks = 0;
+}
+
+//----------------------------------------------------------------------
+// Statistics::~Statistics
+// 	De-allocate the per-thread and per-address space counters.
+//----------------------------------------------------------------------
+
+Statistics::~Statistics()
+{
+    PerfCounters *p, *next;
+
+    for (p = firstCounters; p != NULL; p = next) {
+	next = p->next;
+	delete p;
+    }
+}
+
+//----------------------------------------------------------------------
+// Statistics::NewCounters
+// 	Allocate a set of counters for a new thread or address space.
+//	We keep every set until Nachos halts, so that the work done by 
+//	threads that have already finished still shows up.
+//
+//	"name" is the name to print the counters under
+//----------------------------------------------------------------------
+
+PerfCounters *
+Statistics::NewCounters(char *name)
+{
+    PerfCounters *p = new PerfCounters(name);
+
+    if (lastCounters == NULL)
+	firstCounters = p;
+    else
+	lastCounters->next = p;
+    lastCounters = p;
+    return p;
+}
+
+//----------------------------------------------------------------------
+// Statistics::Charge
+// 	Charge the user and system ticks that have elapsed since the last
+//	call to the running thread and address space.  Since every 
+//	user tick is one instruction, the user ticks also tell us how
+//	many instructions were retired.
+//
+//	Idle ticks are not charged to anyone.
+//----------------------------------------------------------------------
+
+void
+Statistics::Charge()
+{
+    int user = userTicks - lastUserTicks;
+    int system = systemTicks - lastSystemTicks;
+
+    if (threadCounters != NULL) {
+	threadCounters->userTicks += user;
+	threadCounters->systemTicks += system;
+	threadCounters->instructions += user / UserTick;
+    }
+    if (spaceCounters != NULL) {
+	spaceCounters->userTicks += user;
+	spaceCounters->systemTicks += system;
+	spaceCounters->instructions += user / UserTick;
+    }
+    lastUserTicks = userTicks;
+    lastSystemTicks = systemTicks;
+}
+
+//----------------------------------------------------------------------
+// Statistics::SwitchThread
+// Statistics::SwitchSpace
+// 	Note that a different thread (or address space) is about to run.
+//	Whatever the old one did up to now is charged to it first.
+//
+//	"thread", "space" -- the counters of the one about to run; 
+//		the space may be NULL if the thread has no user program
+//----------------------------------------------------------------------
+
+void
+Statistics::SwitchThread(PerfCounters *thread)
+{
+    Charge();
+    threadCounters = thread;
+}
+
+void
+Statistics::SwitchSpace(PerfCounters *space)
+{
+    Charge();
+    spaceCounters = space;
+}
+
+//----------------------------------------------------------------------
+// Statistics::Count
+// 	Record an event, both in the global totals and in the counters 
+//	of the running thread and address space.
+//
+//	"which" -- the kind of event
+//	"amount" -- how many of them (e.g., sectors transferred)
+//----------------------------------------------------------------------
+
+void
+Statistics::Count(PerfEvent which, int amount)
+{
+    PerfCounters *sets[2];
+    int i;
+
+    sets[0] = threadCounters;
+    sets[1] = spaceCounters;
+    switch (which) {
+      case TLBMissEvent:	numTLBMisses += amount; break;
+      case PageFaultEvent:	numPageFaults += amount; break;
+      case SectorReadEvent:	numDiskReads += amount; break;
+      case SectorWriteEvent:	numDiskWrites += amount; break;
+      case ContextSwitchEvent:	numContextSwitches += amount; break;
+    }
+    for (i = 0; i < 2; i++) {
+	if (sets[i] == NULL)
+	    continue;
+	switch (which) {
+	  case TLBMissEvent:	sets[i]->tlbMisses += amount; break;
+	  case PageFaultEvent:	sets[i]->pageFaults += amount; break;
+	  case SectorReadEvent:	sets[i]->sectorsRead += amount; break;
+	  case SectorWriteEvent:	sets[i]->sectorsWritten += amount; break;
+	  case ContextSwitchEvent: sets[i]->contextSwitches += amount; break;
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// Statistics::CountSyscall
+// 	Record a system call made by the running thread.
+//
+//	"type" -- the system call code (cf. syscall.h)
+//----------------------------------------------------------------------
+
+void
+Statistics::CountSyscall(int type)
+{
+    if (type < 0 || type >= NumSyscallCounters)
+	type = NumSyscallCounters - 1;
+    numSyscalls++;
+    if (threadCounters != NULL)
+	threadCounters->syscalls[type]++;
+    if (spaceCounters != NULL)
+	spaceCounters->syscalls[type]++;
 }
 
 //----------------------------------------------------------------------
@@ -36,9 +249,48 @@ Statistics::Print()
     printf("Ticks: total %d, idle %d, system %d, user %d\n", totalTicks, 
 	idleTicks, systemTicks, userTicks);
     printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
+    if (numDiskRequests > 0)
+	printf("Disk scheduling: requests %d, average seek %.2f tracks, "
+	    "request time average %d, max %d\n", numDiskRequests,
+	    (double) diskSeekTracks / numDiskRequests,
+	    diskRequestTicks / numDiskRequests, maxDiskRequestTicks);
+    if (numCacheHits + numCacheMisses > 0)
+	printf("Buffer cache: hits %d, misses %d, writebacks %d\n", 
+	    numCacheHits, numCacheMisses, numCacheWritebacks);
+    if (numPrefetches > 0)
+	printf("Read-ahead: sectors prefetched %d, used %d\n", 
+	    numPrefetches, numPrefetchHits);
+    if (numNameHits + numNameMisses > 0)
+	printf("Name cache: hits %d, misses %d\n", numNameHits, 
+	    numNameMisses);
+    if (numJournalCommits > 0)
+	printf("Journal: transactions %d, sectors logged %d, checkpoints %d\n",
+	    numJournalCommits, numJournalSectors, numJournalCheckpoints);
+    if (numSegmentsCleaned > 0)
+	printf("Log: segments cleaned %d, sectors moved %d\n",
+	    numSegmentsCleaned, numSectorsCleaned);
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
-    printf("Paging: faults %d\n", numPageFaults);
+    printf("Paging: faults %d, TLB misses %d\n", numPageFaults, numTLBMisses);
     printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
 	numPacketsSent);
+    printf("Scheduling: context switches %d, syscalls %d\n", 
+	numContextSwitches, numSyscalls);
+}
+
+//----------------------------------------------------------------------
+// Statistics::PrintCounters
+// 	Print the counters of every thread and address space, so that 
+//	we can tell which one the time went to.
+//----------------------------------------------------------------------
+
+void
+Statistics::PrintCounters()
+{
+    PerfCounters *p;
+
+    Charge();
+    printf("\nPer-thread and per-address space counters:\n");
+    for (p = firstCounters; p != NULL; p = p->next)
+	p->Print();
 }
@@ -13,6 +13,41 @@
 
 #include "copyright.h"
 
+// Events that are charged both to the global totals and to the
+// counters of whichever thread and address space is running.
+
+enum PerfEvent { TLBMissEvent, PageFaultEvent, SectorReadEvent, 
+		 SectorWriteEvent, ContextSwitchEvent };
+
+#define NumSyscallCounters	16	// syscalls numbered above this are
+					// lumped into the last counter
+
+// The following class defines the counters kept for one thread or
+// one address space.  They are owned by the Statistics object, not 
+// by the thread or space, so that they can still be printed at
+// Halt after the thread has finished.
+
+class PerfCounters {
+  public:
+    PerfCounters(char *debugName);	// initialize everything to zero
+    ~PerfCounters();
+
+    void Print();			// print the non-zero counters
+
+    char *name;				// thread or address space name
+    int userTicks;			// time spent executing user code
+    int systemTicks;			// time spent executing system code
+    int instructions;			// user instructions retired
+    int tlbMisses;			// TLB misses
+    int pageFaults;			// page table faults
+    int sectorsRead;			// disk sectors read
+    int sectorsWritten;			// disk sectors written
+    int contextSwitches;		// times switched away from the CPU
+    int syscalls[NumSyscallCounters];	// syscalls made, by number
+
+    PerfCounters *next;			// next counter set in Statistics
+};
+
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
 // many user instructions executed, etc.
@@ -35,10 +70,50 @@ class Statistics {
     int numPageFaults;		// number of virtual memory page faults
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int numTLBMisses;		// number of TLB misses
+    int numContextSwitches;	// number of context switches
+    int numSyscalls;		// number of system calls
+    int numDiskRequests;	// disk requests, each of one or more sectors
+    int diskSeekTracks;		// tracks the disk head has moved
+    int diskRequestTicks;	// total time from disk request to completion
+    int maxDiskRequestTicks;	// longest time for one request
+    int numCacheHits;		// sectors found in the buffer cache
+    int numCacheMisses;		// sectors not found in the buffer cache
+    int numCacheWritebacks;	// dirty buffers written back to disk
+    int numPrefetches;		// sectors read ahead into the cache
+    int numPrefetchHits;	// ... and later asked for
+    int numNameHits;		// path names found in the dentry cache
+    int numNameMisses;		// ... and not found there
+    int numJournalCommits;	// transactions written to the journal
+    int numJournalSectors;	// ... and the sectors they took
+    int numJournalCheckpoints;	// times the journal was emptied
+    int numSegmentsCleaned;	// segments of the log cleaned
+    int numSectorsCleaned;	// ... and the sectors moved out of them
 
     Statistics(); 		// initialize everything to zero
+    ~Statistics();
 
     void Print();		// print collected statistics
+    void PrintCounters();	// print the per-thread and per-space counters
+
+    PerfCounters *NewCounters(char *name);	// allocate a counter set
+    void SwitchThread(PerfCounters *thread);	// the running thread or
+    void SwitchSpace(PerfCounters *space);	// address space changed
+    void Charge();		// charge ticks since the last switch to
+				// the running thread and space
+    void Count(PerfEvent which, int amount = 1);
+				// charge an event to the totals and to
+				// the running thread and space
+    void CountSyscall(int type);	// ditto, for a system call
+
+  private:
+    PerfCounters *firstCounters, *lastCounters;	// all counter sets,
+						// in order of creation
+    PerfCounters *threadCounters;	// counters of the running thread
+    PerfCounters *spaceCounters;	// counters of the running space, 
+					// or NULL
+    int lastUserTicks;		// userTicks at the last Charge()
+    int lastSystemTicks;	// systemTicks at the last Charge()
 };
 
 // Constants used to reflect the relative time an operation would
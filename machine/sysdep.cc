@@ -143,6 +143,44 @@ PollFile(int fd)
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// PollFiles
+// 	Check a set of open files or sockets to see if any of them have
+//	characters that can be read immediately.  Unlike PollFile, we
+//	never delay just to let other processes run: either we return
+//	at once, or we wait (as long as it takes) until one of the files
+//	is ready.
+//
+//	Returns TRUE if any of the files is ready.
+//
+//	"numFiles" -- the number of files to be polled
+//	"fds" -- their file descriptors
+//	"ready" -- set to TRUE for each file that can be read
+//	"block" -- if TRUE, wait until some file is ready
+//----------------------------------------------------------------------
+
+bool
+PollFiles(int numFiles, int *fds, bool *ready, bool block)
+{
+    fd_set rfds;
+    struct timeval pollTime;
+    int i, maxFd = 0, retVal;
+
+    FD_ZERO(&rfds);
+    for (i = 0; i < numFiles; i++) {
+	FD_SET(fds[i], &rfds);
+	if (fds[i] > maxFd)
+	    maxFd = fds[i];
+    }
+    pollTime.tv_sec = 0;
+    pollTime.tv_usec = 0;
+    retVal = select(maxFd + 1, &rfds, NULL, NULL, block ? NULL : &pollTime);
+    ASSERT(retVal >= 0);
+    for (i = 0; i < numFiles; i++)
+	ready[i] = FD_ISSET(fds[i], &rfds) ? TRUE : FALSE;
+    return (retVal > 0);
+}
+
 //----------------------------------------------------------------------
 // OpenForWrite
 // 	Open a file for writing.  Create it if it doesn't exist; truncate it 
@@ -17,6 +17,11 @@
 // If no characters in the file, return without waiting.
 extern bool PollFile(int fd);
 
+// Check several files at once.  Set ready[i] if fds[i] has characters 
+// to be read; if none do, either return at once or (if "block") wait
+// until one does.  Returns TRUE if any file is ready.
+extern bool PollFiles(int numFiles, int *fds, bool *ready, bool block);
+
 // File operations: open/read/write/lseek/close, and check for error
 // For simulating the disk and the console devices.
 extern int OpenForWrite(char *name);
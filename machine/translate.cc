@@ -34,6 +34,9 @@
 #include "addrspace.h"
 #include "system.h"
 
+#include <string.h>
+#include <strings.h>
+
 // Routines for converting Words and Short Words to and from the
 // simulated machine's format of little endian.  These end up
 // being NOPs when the host machine is also little endian (DEC and Intel).
@@ -164,10 +167,147 @@ Machine::WriteMem(int addr, int size, int value)
 	
       default: ASSERT(FALSE);
     }
+
+    // if we just overwrote code, throw away its decoded instructions
+    if (pageDecoded[physicalAddress / PageSize])
+	InvalidateDecodedPage(physicalAddress / PageSize);
     
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Machine::CopyFromUser
+// 	Copy "size" bytes from the user program's virtual memory, starting
+//	at "virtAddr", into the kernel buffer "buffer".
+//
+//	Rather than a ReadMem per byte, we translate once per page and 
+//	copy everything on that page at once.  The use bit of every page
+//	touched is set, exactly as it would be by ReadMem.
+//
+//	Returns FALSE if a page couldn't be translated, in which case the
+//	exception has been raised (with the first bad address), and only
+//	the bytes before that page have been copied.
+//
+//	"virtAddr" -- the virtual address to copy from
+//	"buffer" -- the place to put the data
+//	"size" -- the number of bytes to copy
+//----------------------------------------------------------------------
+
+bool
+Machine::CopyFromUser(int virtAddr, char *buffer, int size)
+{
+    ExceptionType exception;
+    int physicalAddress, chunk;
+
+    DEBUG('a', "Copying %d bytes from VA 0x%x\n", size, virtAddr);
+
+    while (size > 0) {
+	chunk = min(size, PageSize - (int) ((unsigned) virtAddr % PageSize));
+	exception = Translate(virtAddr, &physicalAddress, 1, FALSE);
+	if (exception != NoException) {
+	    machine->RaiseException(exception, virtAddr);
+	    return FALSE;
+	}
+	bcopy(&machine->mainMemory[physicalAddress], buffer, chunk);
+	virtAddr += chunk;
+	buffer += chunk;
+	size -= chunk;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::CopyToUser
+// 	Copy "size" bytes from the kernel buffer "buffer" into the user 
+//	program's virtual memory, starting at "virtAddr".  As with 
+//	CopyFromUser, we translate once per page; the use and dirty bits
+//	of every page touched are set.
+//
+//	Returns FALSE if a page couldn't be translated (or is read-only),
+//	in which case the exception has been raised, and only the bytes 
+//	before that page have been copied.
+//
+//	"virtAddr" -- the virtual address to copy to
+//	"buffer" -- the data to copy
+//	"size" -- the number of bytes to copy
+//----------------------------------------------------------------------
+
+bool
+Machine::CopyToUser(int virtAddr, char *buffer, int size)
+{
+    ExceptionType exception;
+    int physicalAddress, chunk;
+
+    DEBUG('a', "Copying %d bytes to VA 0x%x\n", size, virtAddr);
+
+    while (size > 0) {
+	chunk = min(size, PageSize - (int) ((unsigned) virtAddr % PageSize));
+	exception = Translate(virtAddr, &physicalAddress, 1, TRUE);
+	if (exception != NoException) {
+	    machine->RaiseException(exception, virtAddr);
+	    return FALSE;
+	}
+	bcopy(buffer, &machine->mainMemory[physicalAddress], chunk);
+	if (pageDecoded[physicalAddress / PageSize])
+	    InvalidateDecodedPage(physicalAddress / PageSize);
+	virtAddr += chunk;
+	buffer += chunk;
+	size -= chunk;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::CopyStringFromUser
+// 	Copy a null-terminated string from the user program's virtual
+//	memory, starting at "virtAddr", into the kernel buffer "buffer".
+//	At most "maxLength" bytes are stored, including the terminating
+//	null; a longer string is cut short (but still null-terminated).
+//
+//	We translate once per page, and stop at the page containing the
+//	end of the string, so we never touch memory past it.
+//
+//	Returns the length of the string copied (not counting the null),
+//	or -1 if a page couldn't be translated, in which case the exception
+//	has been raised.
+//
+//	"virtAddr" -- the virtual address of the string
+//	"buffer" -- the place to put the string
+//	"maxLength" -- the size of "buffer"
+//----------------------------------------------------------------------
+
+int
+Machine::CopyStringFromUser(int virtAddr, char *buffer, int maxLength)
+{
+    ExceptionType exception;
+    int physicalAddress, chunk, length = 0;
+    char *from, *end;
+
+    DEBUG('a', "Copying string from VA 0x%x\n", virtAddr);
+    ASSERT(maxLength > 0);
+
+    while (length < maxLength - 1) {
+	chunk = min(maxLength - 1 - length, 
+			PageSize - (int) ((unsigned) virtAddr % PageSize));
+	exception = Translate(virtAddr, &physicalAddress, 1, FALSE);
+	if (exception != NoException) {
+	    machine->RaiseException(exception, virtAddr);
+	    return -1;
+	}
+	from = &machine->mainMemory[physicalAddress];
+	end = (char *) memchr(from, '\0', chunk);
+	if (end != NULL)		// found the end of the string
+	    chunk = end - from;
+	bcopy(from, buffer + length, chunk);
+	length += chunk;
+	if (end != NULL)
+	    break;
+	virtAddr += chunk;
+    }
+    buffer[length] = '\0';
+    return length;
+}
+
 //----------------------------------------------------------------------
 // Machine::Translate
 // 	Translate a virtual address into a physical address, using 
@@ -190,6 +330,20 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     unsigned int vpn, offset;
     TranslationEntry *entry;
     unsigned int pageFrame;
+    CachedTranslation *cached;
+
+// first, see if we translated this page recently.  If so, nothing can
+// have changed since: the use bit (and the dirty bit, if writing) must
+// still be set, since only the kernel can clear them, and the cache is 
+// flushed whenever the kernel has had a chance to run.
+    if (!traceTranslate && !(virtAddr & (size - 1))) {
+	vpn = (unsigned) virtAddr / PageSize;
+	cached = &translationCache[writing][vpn % TranslationCacheSize];
+	if (cached->virtualPage == vpn) {
+	    *physAddr = cached->pageBase + (unsigned) virtAddr % PageSize;
+	    return NoException;
+	}
+    }
 
     DEBUG('a', "\tTranslate 0x%x, %s: ", virtAddr, writing ? "write" : "read");
 
@@ -251,5 +405,28 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     *physAddr = pageFrame * PageSize + offset;
     ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
     DEBUG('a', "phys addr = 0x%x\n", *physAddr);
+
+// remember the translation; a page we can write, we can also read
+    cached = &translationCache[writing][vpn % TranslationCacheSize];
+    cached->virtualPage = vpn;
+    cached->pageBase = pageFrame * PageSize;
+    if (writing)
+	translationCache[FALSE][vpn % TranslationCacheSize] = *cached;
     return NoException;
 }
+
+//----------------------------------------------------------------------
+// Machine::FlushTranslationCache
+// 	Forget all of the translations Translate has remembered, because
+//	the kernel may have changed the page table or the TLB (or cleared
+//	a use or dirty bit, which Translate would then need to set again).
+//----------------------------------------------------------------------
+
+void
+Machine::FlushTranslationCache()
+{
+    for (int i = 0; i < TranslationCacheSize; i++) {
+	translationCache[FALSE][i].virtualPage = NoCachedPage;
+	translationCache[TRUE][i].virtualPage = NoCachedPage;
+    }
+}
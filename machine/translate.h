@@ -42,4 +42,19 @@ class TranslationEntry {
 			// page is modified.
 };
 
+// The following class remembers a recent successful translation, so that 
+// Machine::Translate can skip the page table or TLB when the same page 
+// is used again.  It is part of the simulator, not the simulated hardware:
+// the kernel never sees it, and it has no effect on the simulation other
+// than making it faster.
+
+#define TranslationCacheSize	8	// entries per cache; a power of two
+#define NoCachedPage	0xffffffff	// virtualPage of an unused entry
+
+class CachedTranslation {
+  public:
+    unsigned int virtualPage;	// the page that was translated
+    unsigned int pageBase;	// its physical address in "mainMemory"
+};
+
 #endif
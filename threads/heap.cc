@@ -0,0 +1,202 @@
+// heap.cc 
+//	Routines to manage a priority queue, kept as a binary heap.
+//
+//     	NOTE: Mutual exclusion must be provided by the caller.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "heap.h"
+
+#define InitialHeapSize	16	// elements allocated when the heap is new
+
+//----------------------------------------------------------------------
+// Heap::Heap
+//	Initialize a heap, empty to start with.
+//----------------------------------------------------------------------
+
+Heap::Heap()
+{
+    maxInHeap = InitialHeapSize;
+    elements = new HeapElement[maxInHeap];
+    numInHeap = 0;
+    numInserted = 0;
+}
+
+//----------------------------------------------------------------------
+// Heap::~Heap
+//	De-allocate the heap.  As with a List, we do *not* de-allocate
+//	any items that are still in the heap.
+//----------------------------------------------------------------------
+
+Heap::~Heap()
+{
+    delete [] elements;
+}
+
+//----------------------------------------------------------------------
+// Heap::Before
+//	Return TRUE if element "i" should come out of the heap before 
+//	element "j": it has a smaller key, or the same key and was put 
+//	in first.  (The subtraction makes the insertion order wrap around
+//	gracefully.)
+//----------------------------------------------------------------------
+
+bool
+Heap::Before(int i, int j)
+{
+    if (elements[i].key != elements[j].key)
+	return (elements[i].key < elements[j].key);
+    return ((int) (elements[i].order - elements[j].order) < 0);
+}
+
+//----------------------------------------------------------------------
+// Heap::SiftUp, Heap::SiftDown
+//	Restore the heap property, by moving element "i" up towards the
+//	root (after an insertion), or down towards the leaves (after a 
+//	removal), until it is in its place.
+//----------------------------------------------------------------------
+
+void
+Heap::SiftUp(int i)
+{
+    HeapElement tmp;
+    int parent;
+
+    while (i > 0) {
+	parent = (i - 1) / 2;
+	if (!Before(i, parent))
+	    break;
+	tmp = elements[i];
+	elements[i] = elements[parent];
+	elements[parent] = tmp;
+	i = parent;
+    }
+}
+
+void
+Heap::SiftDown(int i)
+{
+    HeapElement tmp;
+    int child;
+
+    for (;;) {
+	child = 2 * i + 1;
+	if (child >= numInHeap)
+	    break;
+	if ((child + 1 < numInHeap) && Before(child + 1, child))
+	    child++;			// the smaller of the two children
+	if (!Before(child, i))
+	    break;
+	tmp = elements[i];
+	elements[i] = elements[child];
+	elements[child] = tmp;
+	i = child;
+    }
+}
+
+//----------------------------------------------------------------------
+// Heap::Insert
+//      Insert an item into the heap, growing the array if necessary.
+//
+//	"item" is the thing to put in the heap, it can be a pointer to 
+//		anything.
+//	"sortKey" is the priority of the item.
+//----------------------------------------------------------------------
+
+void
+Heap::Insert(void *item, int sortKey)
+{
+    if (numInHeap == maxInHeap) {
+	HeapElement *bigger = new HeapElement[2 * maxInHeap];
+
+	for (int i = 0; i < numInHeap; i++)
+	    bigger[i] = elements[i];
+	delete [] elements;
+	elements = bigger;
+	maxInHeap *= 2;
+    }
+    elements[numInHeap].item = item;
+    elements[numInHeap].key = sortKey;
+    elements[numInHeap].order = numInserted++;
+    numInHeap++;
+    SiftUp(numInHeap - 1);
+}
+
+//----------------------------------------------------------------------
+// Heap::Remove
+//      Remove the item with the smallest key from the heap.
+//
+// Returns:
+//	Pointer to removed item, NULL if nothing is in the heap.
+//	Sets *keyPtr to the priority value of the removed item
+//	(this is needed by interrupt.cc, for instance).
+//
+//	"keyPtr" is a pointer to the location in which to store the 
+//		priority of the removed item.
+//----------------------------------------------------------------------
+
+void *
+Heap::Remove(int *keyPtr)
+{
+    void *item;
+
+    if (numInHeap == 0)
+	return NULL;
+    item = elements[0].item;
+    if (keyPtr != NULL)
+	*keyPtr = elements[0].key;
+    numInHeap--;
+    if (numInHeap > 0) {
+	elements[0] = elements[numInHeap];
+	SiftDown(0);
+    }
+    return item;
+}
+
+//----------------------------------------------------------------------
+// Heap::Peek
+//      Return the item with the smallest key, leaving it in the heap.
+//	Returns NULL if nothing is in the heap.
+//
+//	"keyPtr" is a pointer to the location in which to store the 
+//		priority of the item.
+//----------------------------------------------------------------------
+
+void *
+Heap::Peek(int *keyPtr)
+{
+    if (numInHeap == 0)
+	return NULL;
+    if (keyPtr != NULL)
+	*keyPtr = elements[0].key;
+    return elements[0].item;
+}
+
+//----------------------------------------------------------------------
+// Heap::Mapcar
+//	Apply a function to each item in the heap, in the order they
+//	would be removed (as with a sorted List).  We remove them from a
+//	copy of the heap, so that the heap itself is left alone; this is
+//	only used for debugging, so the time doesn't matter.
+//
+//	"func" is the procedure to apply to each item in the heap.
+//----------------------------------------------------------------------
+
+void
+Heap::Mapcar(VoidFunctionPtr func)
+{
+    Heap copy;
+    int key;
+
+    delete [] copy.elements;
+    copy.maxInHeap = maxInHeap;
+    copy.elements = new HeapElement[maxInHeap];
+    for (int i = 0; i < numInHeap; i++)
+	copy.elements[i] = elements[i];
+    copy.numInHeap = numInHeap;
+    while (!copy.IsEmpty())
+	(*func)((int) copy.Remove(&key));
+}
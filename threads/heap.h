@@ -0,0 +1,62 @@
+// heap.h 
+//	Data structures to manage a priority queue: a binary heap of
+//	items, each with an integer key, from which the item with the
+//	smallest key can be removed.
+//
+//	This is the same interface as the "Sorted" routines of a List
+//	(list.h), and like them, items with equal keys come out in the
+//	order they were put in.  The difference is cost: insertion into
+//	a sorted list is O(n), whereas Insert and Remove on a heap are
+//	O(log n), and Peek is O(1).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef HEAP_H
+#define HEAP_H
+
+#include "copyright.h"
+#include "utility.h"
+
+// The following class defines a "heap element" -- the item, its key,
+// and the order in which it was inserted, used to break ties.
+
+class HeapElement {
+  public:
+    void *item;			// pointer to item in the heap
+    int key;			// priority of the item
+    unsigned int order;		// when the item was inserted
+};
+
+// The following class defines the heap itself, kept in an array
+// which grows as needed: elements[0] is the smallest item, and the
+// children of elements[i] are elements[2i+1] and elements[2i+2].
+
+class Heap {
+  public:
+    Heap();			// initialize the heap
+    ~Heap();			// de-allocate the heap
+
+    void Insert(void *item, int sortKey);  // Put item into heap
+    void *Remove(int *keyPtr);	// Remove the smallest item from the heap
+    void *Peek(int *keyPtr);	// Return the smallest item, without 
+				// removing it
+
+    void Mapcar(VoidFunctionPtr func);	// Apply "func" to every item in
+					// the heap, in key order
+    int NumInHeap() { return numInHeap; }
+    bool IsEmpty() { return (numInHeap == 0); }
+
+  private:
+    HeapElement *elements;	// the heap, in an array
+    int numInHeap;		// number of items in the heap
+    int maxInHeap;		// size of "elements"
+    unsigned int numInserted;	// number of items ever inserted
+
+    bool Before(int i, int j);	// does element i come out before j?
+    void SiftUp(int i);		// move element i up to its place
+    void SiftDown(int i);	// move element i down to its place
+};
+
+#endif // HEAP_H
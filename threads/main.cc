@@ -8,29 +8,43 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
-//		-s -x <nachos file> -c <consoleIn> <consoleOut>
-//		-f -cp <unix file> <nachos file>
-//		-p <nachos file> -r <nachos file> -l -D -t
+// Usage: nachos -d <debugflags> -rs <random seed #> -ff -T <trace file>
+//		-s -bb -prof <ticks> -x <nachos file> -c <consoleIn> <consoleOut>
+//		-f -lfs -ds <disk policy> -cp <unix file> <nachos file>
+//		-p <nachos file> -r <nachos file> -mkdir <nachos directory>
+//		-l -D -t
 //              -n <network reliability> -m <machine id>
 //              -o <other machine id>
 //              -z
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -ff causes idle time to be skipped, rather than simulated by
+//	polling the console and network
+//    -T records thread switches, interrupts, disk requests, exceptions
+//	and syscalls, and writes them to a file for bin/tracedump
 //    -z prints the copyright message
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
+//    -bb causes user programs to be run a basic block at a time, 
+//	rather than an instruction at a time (faster, same results)
+//    -prof samples the user PC every so many user ticks, and writes
+//	a profile of the user program when Nachos exits
 //    -x runs a user program
 //    -c tests the console
 //
 //  FILESYS
 //    -f causes the physical disk to be formatted
+//    -lfs, with -f, formats it log-structured: file data is written
+//	to the disk as a log, a track at a time
+//    -ds sets the order disk requests are done in: queue (the disk
+//	decides; the default), fcfs, sstf, scan, clook, or deadline
 //    -cp copies a file from UNIX to Nachos
 //    -p prints a Nachos file to stdout
-//    -r removes a Nachos file from the file system
-//    -l lists the contents of the Nachos directory
+//    -r removes a Nachos file (or empty directory) from the file system
+//    -mkdir creates a Nachos directory
+//    -l lists the contents of the Nachos root directory
 //    -D prints the contents of the entire file system 
 //    -t tests the performance of the Nachos file system
 //
@@ -139,6 +153,11 @@ main(int argc, char **argv)
 	    ASSERT(argc > 1);
 	    fileSystem->Remove(*(argv + 1));
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-mkdir")) {	// make a Nachos directory
+	    ASSERT(argc > 1);
+	    if (!fileSystem->MakeDirectory(*(argv + 1)))
+		printf("Could not create directory %s\n", *(argv + 1));
+	    argCount = 2;
 	} else if (!strcmp(*argv, "-l")) {	// list Nachos directory
             fileSystem->List();
 	} else if (!strcmp(*argv, "-D")) {	// print entire filesystem
@@ -102,6 +102,11 @@ Scheduler::Run (Thread *nextThread)
     oldThread->CheckOverflow();		    // check if the old thread
 					    // had an undetected stack overflow
 
+    stats->Count(ContextSwitchEvent);	    // charge the old thread for
+    stats->SwitchThread(nextThread->perf);  // the switch and its time
+
+    if (trace != NULL)
+	trace->Switch(nextThread->getId());
     currentThread = nextThread;		    // switch to the next thread
     currentThread->setStatus(RUNNING);      // nextThread is now running
     
@@ -18,6 +18,7 @@ Interrupt *interrupt;			// interrupt status
 Statistics *stats;			// performance metrics
 Timer *timer;				// the hardware timer device,
 					// for invoking context switches
+Trace *trace;				// event trace, or NULL
 
 #ifdef FILESYS_NEEDED
 FileSystem  *fileSystem;
@@ -25,10 +26,14 @@ FileSystem  *fileSystem;
 
 #ifdef FILESYS
 SynchDisk   *synchDisk;
+BufferCache *bufferCache;
+VnodeTable  *vnodeTable;
+Journal     *journal;
 #endif
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
+Profiler *profiler;	// samples user PCs, or NULL
 #endif
 
 #ifdef NETWORK
@@ -80,12 +85,20 @@ Initialize(int argc, char **argv)
     int argCount;
     char* debugArgs = "";
     bool randomYield = FALSE;
+    bool fastForward = FALSE;	// skip idle time, rather than polling
+    char *traceFile = NULL;	// where to write the event trace
 
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    bool runBlocks = FALSE;	// run user programs a basic block at a time
+    int profileInterval = 0;	// user ticks between profile samples
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
+    bool logStructured = FALSE;	// ... to write file data as a log
+#endif
+#ifdef FILESYS
+    DiskPolicy diskPolicy = DiskQueue;	// order of disk requests
 #endif
 #ifdef NETWORK
     double rely = 1;		// network reliability
@@ -107,14 +120,39 @@ Initialize(int argc, char **argv)
 						// number generator
 	    randomYield = TRUE;
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-ff"))
+	    fastForward = TRUE;
+	else if (!strcmp(*argv, "-T")) {
+	    ASSERT(argc > 1);
+	    traceFile = *(argv + 1);
+	    argCount = 2;
 	}
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
+	else if (!strcmp(*argv, "-bb"))
+	    runBlocks = TRUE;
+	else if (!strcmp(*argv, "-prof")) {
+	    ASSERT(argc > 1);
+	    profileInterval = atoi(*(argv + 1));
+	    argCount = 2;
+	}
 #endif
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
 	    format = TRUE;
+	else if (!strcmp(*argv, "-lfs"))
+	    logStructured = TRUE;
+#endif
+#ifdef FILESYS
+	if (!strcmp(*argv, "-ds")) {
+	    ASSERT(argc > 1);
+	    if (!SynchDisk::PolicyNamed(*(argv + 1), &diskPolicy)) {
+		printf("Unknown disk scheduling policy %s\n", *(argv + 1));
+		ASSERT(FALSE);
+	    }
+	    argCount = 2;
+	}
 #endif
 #ifdef NETWORK
 	if (!strcmp(*argv, "-l")) {
@@ -131,7 +169,8 @@ Initialize(int argc, char **argv)
 
     DebugInit(debugArgs);			// initialize DEBUG messages
     stats = new Statistics();			// collect statistics
-    interrupt = new Interrupt;			// start up interrupt handling
+    trace = (traceFile != NULL) ? new Trace(traceFile) : NULL;
+    interrupt = new Interrupt(fastForward);	// start up interrupt handling
     scheduler = new Scheduler();		// initialize the ready queue
     if (randomYield)				// start the timer (if needed)
 	timer = new Timer(TimerInterruptHandler, 0, randomYield);
@@ -143,20 +182,25 @@ Initialize(int argc, char **argv)
     // object to save its state. 
     currentThread = new Thread("main");		
     currentThread->setStatus(RUNNING);
+    stats->SwitchThread(currentThread->perf);
 
     interrupt->Enable();
     CallOnUserAbort(Cleanup);			// if user hits ctl-C
     
 #ifdef USER_PROGRAM
-    machine = new Machine(debugUserProg);	// this must come first
+    machine = new Machine(debugUserProg, runBlocks); // this must come first
+    profiler = (profileInterval > 0) ? new Profiler(profileInterval) : NULL;
 #endif
 
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    synchDisk = new SynchDisk("DISK", diskPolicy);
+    bufferCache = new BufferCache(synchDisk);
+    vnodeTable = new VnodeTable;
+    journal = new Journal;
 #endif
 
 #ifdef FILESYS_NEEDED
-    fileSystem = new FileSystem(format);
+    fileSystem = new FileSystem(format, logStructured);
 #endif
 
 #ifdef NETWORK
@@ -172,25 +216,37 @@ void
 Cleanup()
 {
     printf("\nCleaning up...\n");
+#ifdef FILESYS_NEEDED			// first, since it may write to disk
+    delete fileSystem;
+#endif
+
 #ifdef NETWORK
     delete postOffice;
 #endif
     
 #ifdef USER_PROGRAM
+    if (profiler != NULL) {
+	profiler->Write();
+	delete profiler;
+    }
     delete machine;
 #endif
 
-#ifdef FILESYS_NEEDED
-    delete fileSystem;
-#endif
-
 #ifdef FILESYS
+    delete journal;
+    delete vnodeTable;
+    delete bufferCache;
     delete synchDisk;
 #endif
     
     delete timer;
     delete scheduler;
     delete interrupt;
+
+    if (trace != NULL) {
+	trace->Write();
+	delete trace;
+    }
     
     Exit(0);
 }
@@ -24,6 +24,8 @@
 					// execution stack, for detecting 
 					// stack overflows
 
+static int numThreads = 0;		// threads created so far, for ids
+
 //----------------------------------------------------------------------
 // Thread::Thread
 // 	Initialize a thread control block, so that we can then call
@@ -38,6 +40,10 @@ Thread::Thread(char* threadName)
     stackTop = NULL;
     stack = NULL;
     status = JUST_CREATED;
+    perf = stats->NewCounters(threadName);
+    id = numThreads++;
+    if (trace != NULL)
+	trace->NameThread(id, threadName);
 #ifdef USER_PROGRAM
     space = NULL;
 #endif
@@ -147,6 +153,7 @@ Thread::Finish ()
     ASSERT(this == currentThread);
     
     DEBUG('t', "Finishing thread \"%s\"\n", getName());
+    TRACE(TraceFinish, 0, 0);
     
     threadToBeDestroyed = currentThread;
     Sleep();					// invokes SWITCH
@@ -39,6 +39,7 @@
 
 #include "copyright.h"
 #include "utility.h"
+#include "stats.h"
 
 #ifdef USER_PROGRAM
 #include "machine.h"
@@ -100,8 +101,12 @@ class Thread {
 						// overflowed its stack
     void setStatus(ThreadStatus st) { status = st; }
     char* getName() { return (name); }
+    int getId() { return (id); }
     void Print() { printf("%s, ", name); }
 
+    PerfCounters *perf;			// what this thread has cost us;
+					// owned by "stats"
+
   private:
     // some of the private data for this class is listed above
     
@@ -110,6 +115,7 @@ class Thread {
 					// (If NULL, don't deallocate stack)
     ThreadStatus status;		// ready, running or blocked
     char* name;
+    int id;				// unique, in order of creation
 
     void StackAllocate(VoidFunctionPtr func, void *arg);
     					// Allocate a stack for thread.
@@ -0,0 +1,105 @@
+// trace.cc
+//	Routines to record kernel events in a ring buffer, and to write
+//	them out when Nachos exits.  See trace.h for an overview.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "trace.h"
+#include "system.h"
+#include <strings.h>
+
+//----------------------------------------------------------------------
+// Trace::Trace
+// 	Start a trace.  Nothing is written until Write is called.
+//
+//	"traceFile" -- the UNIX file to write the trace to
+//----------------------------------------------------------------------
+
+Trace::Trace(char *traceFile)
+{
+    fileName = traceFile;
+    ring = new TraceRecord[TraceRingSize];
+    next = 0;
+    running = 0;
+    maxNames = 16;
+    names = new TraceName[maxNames];
+    numNames = 0;
+}
+
+//----------------------------------------------------------------------
+// Trace::~Trace
+// 	De-allocate the trace.
+//----------------------------------------------------------------------
+
+Trace::~Trace()
+{
+    delete [] ring;
+    delete [] names;
+}
+
+//----------------------------------------------------------------------
+// Trace::NameThread
+// 	Remember the name of a thread, so that the decoder can print it.
+//	Names are kept apart from the ring, so they are never overwritten.
+//
+//	"thread" -- the thread's id
+//	"name" -- its name; we keep a copy
+//----------------------------------------------------------------------
+
+void
+Trace::NameThread(int thread, char *name)
+{
+    TraceName *bigger;
+
+    if (numNames == maxNames) {
+	bigger = new TraceName[maxNames * 2];
+	bcopy(names, bigger, maxNames * sizeof(TraceName));
+	delete [] names;
+	names = bigger;
+	maxNames *= 2;
+    }
+    names[numNames].thread = thread;
+    strncpy(names[numNames].name, name, TraceNameLength - 1);
+    names[numNames].name[TraceNameLength - 1] = '\0';
+    numNames++;
+}
+
+//----------------------------------------------------------------------
+// Trace::Write
+// 	Write the events in the ring, oldest first, and the thread names
+//	to the trace file.
+//----------------------------------------------------------------------
+
+void
+Trace::Write()
+{
+    TraceFileHeader header;
+    unsigned int first, count, start;
+    int fd;
+
+    count = (next < TraceRingSize) ? next : TraceRingSize;
+    first = next - count;
+    header.magic = TRACEMAGIC;
+    header.version = TRACEVERSION;
+    header.numRecords = count;
+    header.numNames = numNames;
+    header.dropped = first;
+
+    fd = OpenForWrite(fileName);
+    WriteFile(fd, (char *) &header, sizeof(header));
+    start = first & (TraceRingSize - 1);
+    if (start + count > TraceRingSize) {	// the ring has wrapped
+	WriteFile(fd, (char *) &ring[start],
+		(TraceRingSize - start) * sizeof(TraceRecord));
+	WriteFile(fd, (char *) ring,
+		(start + count - TraceRingSize) * sizeof(TraceRecord));
+    } else
+	WriteFile(fd, (char *) &ring[start], count * sizeof(TraceRecord));
+    WriteFile(fd, (char *) names, numNames * sizeof(TraceName));
+    Close(fd);
+    printf("Trace of %d events (%d dropped) written to %s\n", count,
+	first, fileName);
+}
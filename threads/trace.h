@@ -0,0 +1,68 @@
+// trace.h
+//	Data structures for a cheap binary trace of kernel events.
+//
+//	Unlike DEBUG, which formats a line of text for each event,
+//	recording an event here just fills in a few words of a ring
+//	buffer in memory: the time, the running thread, and two
+//	arguments.  When the ring is full, the oldest events are
+//	overwritten.  The buffer is only written to a file when Nachos
+//	exits; bin/tracedump turns the file into text or into JSON for
+//	a Chrome trace viewer.
+//
+//	The format of the trace file is in tracefmt.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "stats.h"
+#include "tracefmt.h"
+
+#define TraceRingSize	65536	// events kept; must be a power of two
+
+extern Statistics *stats;
+
+class Trace {
+  public:
+    Trace(char *traceFile);		// start tracing
+    ~Trace();				// de-allocate the trace
+
+    void Record(int type, int arg1, int arg2) {
+	TraceRecord *r = &ring[next & (TraceRingSize - 1)];
+	r->time = stats->totalTicks;
+	r->type = type;
+	r->thread = running;
+	r->arg1 = arg1;
+	r->arg2 = arg2;
+	next++;
+    }					// record an event
+    void Switch(int thread) {
+	Record(TraceSwitch, thread, 0);
+	running = thread;
+    }					// record a context switch
+    void NameThread(int thread, char *name);	// remember a thread's name
+
+    void Write();			// write the trace to the file
+
+  private:
+    char *fileName;			// where to write the trace
+    TraceRecord *ring;			// the events
+    unsigned int next;			// number of events ever recorded
+    int running;			// id of the running thread
+
+    TraceName *names;			// names of the threads seen so far
+    int numNames;
+    int maxNames;			// how big "names" is
+};
+
+// Record an event, if we are tracing.  An expression, so that it is
+// safe inside an if-else.
+#define TRACE(type, arg1, arg2)	\
+    ((trace != NULL) ? trace->Record(type, arg1, arg2) : (void) 0)
+
+#endif // TRACE_H
@@ -0,0 +1,60 @@
+/* tracefmt.h
+ *	The layout of a Nachos event trace file, shared between the
+ *	kernel (which writes it, see trace.h) and bin/tracedump (which
+ *	turns it back into text or Chrome trace JSON).
+ *
+ *	This file is included by C code, so no C++ here!
+ *
+ *	A trace file is:
+ *		a TraceFileHeader
+ *		"numRecords" TraceRecords, oldest first
+ *		"numNames" TraceNames, giving the names of the threads
+ *
+ *	Everything is in the byte order of the host that wrote it.
+ *
+ * Copyright (c) 1992-1993 The Regents of the University of California.
+ * All rights reserved.  See copyright.h for copyright notice and limitation
+ * of liability and disclaimer of warranty provisions.
+ */
+
+#ifndef TRACEFMT_H
+#define TRACEFMT_H
+
+#define TRACEMAGIC	0x4e545243	/* "NTRC" */
+#define TRACEVERSION	1
+
+/* The kinds of event, and what their arguments mean */
+#define TraceSwitch	1	/* context switch: arg1 = new thread id */
+#define TraceInterrupt	2	/* interrupt handler called: arg1 = IntType */
+#define TraceDiskRead	3	/* disk read request: arg1 = first sector,
+				 *	arg2 = # of sectors */
+#define TraceDiskWrite	4	/* disk write request: ditto */
+#define TraceException	5	/* user exception: arg1 = ExceptionType,
+				 *	arg2 = bad virtual address */
+#define TraceSyscall	6	/* system call: arg1 = syscall code */
+#define TraceFinish	7	/* the running thread finished */
+
+#define TraceNameLength	28	/* longest thread name we keep */
+
+typedef struct {
+    unsigned int magic;		/* TRACEMAGIC */
+    unsigned int version;	/* TRACEVERSION */
+    unsigned int numRecords;	/* number of TraceRecords that follow */
+    unsigned int numNames;	/* number of TraceNames after those */
+    unsigned int dropped;	/* older events overwritten in the ring */
+} TraceFileHeader;
+
+typedef struct {
+    unsigned int time;		/* stats->totalTicks */
+    unsigned short type;	/* TraceSwitch, ... */
+    unsigned short thread;	/* id of the thread running at the time */
+    unsigned int arg1;		/* depends on "type" */
+    unsigned int arg2;
+} TraceRecord;
+
+typedef struct {
+    unsigned int thread;	/* thread id */
+    char name[TraceNameLength];	/* its name, null terminated */
+} TraceName;
+
+#endif /* TRACEFMT_H */
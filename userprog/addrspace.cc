@@ -64,6 +64,11 @@ AddrSpace::AddrSpace(OpenFile *executable)
 {
     NoffHeader noffH;
     unsigned int i, size;
+    static int numSpaces = 0;
+    char name[32];
+
+    sprintf(name, "space %d", numSpaces++);
+    perf = stats->NewCounters(name);
 
     executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
     if ((noffH.noffMagic != NOFFMAGIC) && 
@@ -116,6 +121,10 @@ AddrSpace::AddrSpace(OpenFile *executable)
 			noffH.initData.size, noffH.initData.inFileAddr);
     }
 
+// we wrote main memory behind the simulator's back, so it must forget 
+// any instructions it decoded from these pages for a previous program
+    for (i = 0; i < numPages; i++)
+	machine->InvalidateDecodedPage(pageTable[i].physicalPage);
 }
 
 //----------------------------------------------------------------------
@@ -165,22 +174,28 @@ AddrSpace::InitRegisters()
 // 	On a context switch, save any machine state, specific
 //	to this address space, that needs saving.
 //
-//	For now, nothing!
+//	For now, just charge this program for the time it ran.
 //----------------------------------------------------------------------
 
 void AddrSpace::SaveState() 
-{}
+{
+    stats->SwitchSpace(NULL);
+}
 
 //----------------------------------------------------------------------
 // AddrSpace::RestoreState
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      For now, tell the machine where to find the page table, and
+//	have it forget the translations it did with the old one.  From
+//	here on, the time spent is charged to this program.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
     machine->pageTable = pageTable;
     machine->pageTableSize = numPages;
+    machine->FlushTranslationCache();
+    stats->SwitchSpace(perf);
 }
@@ -15,6 +15,7 @@
 
 #include "copyright.h"
 #include "filesys.h"
+#include "stats.h"
 
 #define UserStackSize		1024 	// increase this as necessary!
 
@@ -36,6 +37,8 @@ class AddrSpace {
 					// for now!
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
+    PerfCounters *perf;			// what this program has cost us;
+					// owned by "stats"
 };
 
 #endif // ADDRSPACE_H
@@ -8,6 +8,11 @@
 
 #include "copyright.h"
 #include "bitmap.h"
+#include "disk.h"
+
+// Word operations; the compiler turns these into an instruction or two.
+#define CountTrailingZeros(word)	__builtin_ctz(word)	// word != 0
+#define CountOnes(word)			__builtin_popcount(word)
 
 //----------------------------------------------------------------------
 // BitMap::BitMap
@@ -21,9 +26,14 @@ BitMap::BitMap(int nitems)
 { 
     numBits = nitems;
     numWords = divRoundUp(numBits, BitsInWord);
+    numSummaryWords = divRoundUp(numWords, BitsInWord);
     map = new unsigned int[numWords];
-    for (int i = 0; i < numBits; i++) 
-        Clear(i);
+    full = new unsigned int[numSummaryWords];
+    for (int i = 0; i < numWords; i++) 
+        map[i] = 0;
+    Rebuild();
+    dirtyFrom = 0;
+    dirtyTo = numWords;
 }
 
 //----------------------------------------------------------------------
@@ -33,7 +43,8 @@ BitMap::BitMap(int nitems)
 
 BitMap::~BitMap()
 { 
-    delete map;
+    delete [] map;
+    delete [] full;
 }
 
 //----------------------------------------------------------------------
@@ -48,6 +59,8 @@ BitMap::Mark(int which)
 { 
     ASSERT(which >= 0 && which < numBits);
     map[which / BitsInWord] |= 1 << (which % BitsInWord);
+    UpdateSummary(which / BitsInWord);
+    Changed(which / BitsInWord);
 }
     
 //----------------------------------------------------------------------
@@ -62,6 +75,8 @@ BitMap::Clear(int which)
 {
     ASSERT(which >= 0 && which < numBits);
     map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
+    UpdateSummary(which / BitsInWord);
+    Changed(which / BitsInWord);
 }
 
 //----------------------------------------------------------------------
@@ -94,12 +109,62 @@ BitMap::Test(int which)
 int 
 BitMap::Find() 
 {
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) {
-	    Mark(i);
-	    return i;
+    int i = NextClear(0);
+
+    if (i == numBits)
+	return -1;
+    Mark(i);
+    return i;
+}
+
+//----------------------------------------------------------------------
+// BitMap::FindRun
+// 	Find "count" consecutive clear bits, all within one block of 
+//	"within" bits (for instance, all on one disk track), and set them.
+//	The search starts at "hint", and wraps around to the beginning;
+//	the first suitable run found is taken.
+//
+//	We go from one run of clear bits to the next, rather than a bit
+//	at a time, and take the earliest place in each run where "count"
+//	bits fit without crossing a block boundary.
+//
+//	Return the number of the first bit of the run, or -1 if there
+//	isn't one.
+//
+//	"count" is the number of bits wanted
+//	"within" is the size of the blocks the run must fit in
+//	"hint" is where to start looking, e.g. next to related bits
+//----------------------------------------------------------------------
+
+int
+BitMap::FindRun(int count, int within, int hint)
+{
+    int i, first, runEnd;
+    bool wrapped = FALSE;
+
+    ASSERT(count > 0 && count <= within);
+    if ((hint < 0) || (hint >= numBits))
+	hint = 0;
+    for (i = NextClear(hint); ; i = NextClear(runEnd)) {
+	if (i == numBits) {
+	    if (wrapped || (hint == 0))
+		return -1;
+	    wrapped = TRUE;		// try again from the beginning
+	    runEnd = 0;
+	    continue;
+	}
+	if (wrapped && (i >= hint))
+	    return -1;			// already looked here
+	runEnd = NextSet(i);
+	first = i;
+	if ((first % within) + count > within)	// go to the next block
+	    first += within - (first % within);
+	if (first + count <= runEnd) {
+	    for (i = first; i < first + count; i++)
+		Mark(i);
+	    return first;
 	}
-    return -1;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -113,11 +178,128 @@ BitMap::NumClear()
 {
     int count = 0;
 
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) count++;
+    for (int i = 0; i < numWords; i++)
+	count += CountOnes(~map[i]);	// unused bits at the end are set
     return count;
 }
 
+//----------------------------------------------------------------------
+// BitMap::NextClear
+// 	Return the number of the first clear bit at or after "from", or
+//	numBits if there isn't one.  Full words are skipped using the
+//	summary.
+//----------------------------------------------------------------------
+
+int
+BitMap::NextClear(int from)
+{
+    int w = from / BitsInWord, s;
+    unsigned int bits, summary;
+
+    if (from >= numBits)
+	return numBits;
+    bits = ~map[w] & (~0u << (from % BitsInWord));
+    while (bits == 0) {
+	w++;				// find the next word that isn't full
+	if (w >= numWords)
+	    return numBits;
+	s = w / BitsInWord;
+	summary = ~full[s] & (~0u << (w % BitsInWord));
+	while (summary == 0) {
+	    if (++s >= numSummaryWords)
+		return numBits;
+	    summary = ~full[s];
+	}
+	w = s * BitsInWord + CountTrailingZeros(summary);
+	if (w >= numWords)
+	    return numBits;
+	bits = ~map[w];
+    }
+    return w * BitsInWord + CountTrailingZeros(bits);
+}
+
+//----------------------------------------------------------------------
+// BitMap::NextSet
+// 	Return the number of the first set bit at or after "from", or
+//	numBits if there isn't one.
+//----------------------------------------------------------------------
+
+int
+BitMap::NextSet(int from)
+{
+    int w = from / BitsInWord, i;
+    unsigned int bits;
+
+    if (from >= numBits)
+	return numBits;
+    bits = map[w] & (~0u << (from % BitsInWord));
+    while (bits == 0) {
+	if (++w >= numWords)
+	    return numBits;
+	bits = map[w];
+    }
+    i = w * BitsInWord + CountTrailingZeros(bits);
+    return (i < numBits) ? i : numBits;
+}
+
+//----------------------------------------------------------------------
+// BitMap::UpdateSummary
+// 	Note in the summary whether a word of the bitmap is now full.
+//
+//	"word" is the number of the word that changed
+//----------------------------------------------------------------------
+
+void
+BitMap::UpdateSummary(int word)
+{
+    if (map[word] == ~0u)
+	full[word / BitsInWord] |= 1 << (word % BitsInWord);
+    else
+	full[word / BitsInWord] &= ~(1 << (word % BitsInWord));
+}
+
+//----------------------------------------------------------------------
+// BitMap::Changed
+// 	Note that a word of the bitmap has changed, so that WriteBack
+//	will write it.
+//
+//	"word" is the number of the word that changed
+//----------------------------------------------------------------------
+
+void
+BitMap::Changed(int word)
+{
+    if (dirtyFrom == dirtyTo) {
+	dirtyFrom = word;
+	dirtyTo = word + 1;
+    } else if (word < dirtyFrom)
+	dirtyFrom = word;
+    else if (word >= dirtyTo)
+	dirtyTo = word + 1;
+}
+
+//----------------------------------------------------------------------
+// BitMap::Rebuild
+// 	Recompute the summary, after the whole bitmap has changed.  The
+//	bits past numBits in the last word are kept set, so that they are 
+//	never found free; likewise for the summary.
+//----------------------------------------------------------------------
+
+void
+BitMap::Rebuild()
+{
+    int i;
+
+    if (numBits % BitsInWord != 0)
+	map[numWords - 1] |= ~0u << (numBits % BitsInWord);
+    for (i = 0; i < numSummaryWords; i++)
+	full[i] = 0;
+    if (numWords % BitsInWord != 0)
+	full[numSummaryWords - 1] = ~0u << (numWords % BitsInWord);
+    for (i = 0; i < numWords; i++)
+	UpdateSummary(i);
+}
+
 //----------------------------------------------------------------------
 // BitMap::Print
 // 	Print the contents of the bitmap, for debugging.
@@ -149,11 +331,15 @@ void
 BitMap::FetchFrom(OpenFile *file) 
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    Rebuild();
+    dirtyFrom = dirtyTo = 0;
 }
 
 //----------------------------------------------------------------------
 // BitMap::WriteBack
-// 	Store the contents of a bitmap to a Nachos file.
+// 	Store the contents of a bitmap to a Nachos file.  Only the
+//	sectors of the file holding words that have changed are written;
+//	whole sectors, so that the file system needn't read them first.
 //
 //	"file" is the place to write the bitmap to
 //----------------------------------------------------------------------
@@ -161,5 +347,14 @@ BitMap::FetchFrom(OpenFile *file)
 void
 BitMap::WriteBack(OpenFile *file)
 {
-   file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
+    int from, to;
+
+    if (dirtyFrom == dirtyTo)
+	return;				// nothing has changed
+    from = divRoundDown(dirtyFrom * sizeof(unsigned), SectorSize) * SectorSize;
+    to = divRoundUp(dirtyTo * sizeof(unsigned), SectorSize) * SectorSize;
+    if (to > numWords * (int) sizeof(unsigned))
+	to = numWords * sizeof(unsigned);
+    file->WriteAt((char *)map + from, to - from, from);
+    dirtyFrom = dirtyTo = 0;
 }
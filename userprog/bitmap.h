@@ -3,7 +3,10 @@
 //	can be either on or off.
 //
 //	Represented as an array of unsigned integers, on which we do
-//	modulo arithmetic to find the bit we are interested in.
+//	modulo arithmetic to find the bit we are interested in.  Searches
+//	go a word at a time, and a second, "summary" bitmap -- one bit per
+//	word, set when the word is full -- lets them skip full words 
+//	quickly.
 //
 //	The bitmap can be parameterized with with the number of bits being 
 //	managed.
@@ -43,6 +46,12 @@ class BitMap {
     int Find();            	// Return the # of a clear bit, and as a side
 				// effect, set the bit. 
 				// If no bits are clear, return -1.
+    int FindRun(int count, int within, int hint = 0);
+				// Find "count" clear bits in a row, that
+				// don't cross a multiple of "within", 
+				// starting the search at "hint"; set them,
+				// and return the # of the first.
+				// If there aren't any, return -1.
     int NumClear();		// Return the number of clear bits
 
     void Print();		// Print contents of bitmap
@@ -50,7 +59,8 @@ class BitMap {
     // These aren't needed until FILESYS, when we will need to read and 
     // write the bitmap to a file
     void FetchFrom(OpenFile *file); 	// fetch contents from disk 
-    void WriteBack(OpenFile *file); 	// write contents to disk
+    void WriteBack(OpenFile *file); 	// write the sectors that have
+					// changed back to disk
 
   private:
     int numBits;			// number of bits in the bitmap
@@ -59,6 +69,19 @@ class BitMap {
 					//  multiple of the number of bits in
 					//  a word)
     unsigned int *map;			// bit storage
+    unsigned int *full;			// bit "w" is set if map[w] is full
+    int numSummaryWords;		// # of words in "full"
+    int dirtyFrom, dirtyTo;		// words changed since the last
+					// FetchFrom/WriteBack; all of them,
+					// to start with
+
+    void UpdateSummary(int word);	// after map[word] changes
+    void Changed(int word);		// note that map[word] must be
+					// written back
+    void Rebuild();			// after all of "map" changes
+    int NextClear(int from);		// # of the first clear bit at or
+					// after "from", or numBits
+    int NextSet(int from);		// ditto, for a set bit
 };
 
 #endif // BITMAP_H
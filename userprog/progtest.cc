@@ -32,6 +32,8 @@ StartProcess(char *filename)
     }
     space = new AddrSpace(executable);    
     currentThread->space = space;
+    if (profiler != NULL)
+	profiler->LoadSymbols(filename);
 
     delete executable;			// close file
 